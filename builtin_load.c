@@ -24,6 +24,8 @@ static eval_err_t loadlibfn(memory_state_t *ms, node_t **n, node_t **result, voi
 	node_t *cursor, *val;
 	node_t *env_handle = (node_t *) p;
 
+	*result = NULL;
+
 	/* count path length */
 	if(count_list_len(n[0], &len) != 0) {
 		status = eval_err(EVAL_ERR_EXPECTED_CONS);
@@ -70,13 +72,17 @@ eval_err_t foreign_loadlib(memory_state_t *ms, node_t *args, node_t *env_handle,
 	return extract_args(ms, 1, loadlibfn, args, result, env_handle);
 }
 
+/* _read-eval calls in progress: only the outermost one evaluates top level
+   forms, the others run inside an outer form */
+static unsigned int read_eval_depth = 0;
+
 static eval_err_t readevalfn(memory_state_t *ms, node_t **n, node_t **result, void *p)
 {
 	char *path = NULL;
 	int map_status;
 	size_t len;
 	node_t *cursor, *val;
-	node_t *env_handle = (node_t *) p;
+	node_t *env_handle;
 
 	parse_err_t parse_stat;
 	filemap_info_t info;
@@ -85,6 +91,21 @@ static eval_err_t readevalfn(memory_state_t *ms, node_t **n, node_t **result, vo
 	bufstream_t bs;
 	eval_err_t eval_stat = EVAL_OK;
 	node_t *eval_in_hdl = NULL, *eval_out_hdl = NULL;
+	/* compact the heap between top level forms once this percentage of its
+	   cells is free */
+	unsigned int compact = getenv("PAREN_COMPACT")
+	                       ? strtoul(getenv("PAREN_COMPACT"), NULL, 0) : 0;
+	/* parse and eval each top level form in a scratch region of its own */
+	bool region = getenv("PAREN_REGION") != NULL, in_region = false;
+
+	*result = NULL;
+	read_eval_depth++;
+	/* regions do not nest: a nested call runs in its caller's form */
+	region = region && read_eval_depth == 1;
+	/* a call from a lambda gets its unlocked environment handle, which
+	   compaction would move */
+	node_roots_push(ms, &env_handle, 1);
+	node_root_set(ms, &env_handle, (node_t *) p);
 
 	/* count path length */
 	if(count_list_len(n[0], &len) != 0) {
@@ -129,7 +150,15 @@ static eval_err_t readevalfn(memory_state_t *ms, node_t **n, node_t **result, vo
 	eval_in_hdl = node_lockroot(node_handle_new(ms, NULL));
 	eval_out_hdl = node_lockroot(node_handle_new(ms, NULL));
 
-	while((parse_stat = parse(ms, &ts, eval_in_hdl)) != PARSE_END) {
+	for(;;) {
+		if(region) {
+			memory_region_begin(ms);
+			in_region = true;
+		}
+		parse_stat = parse(ms, &ts, eval_in_hdl);
+		if(parse_stat == PARSE_END) {
+			break;
+		}
 		if(parse_stat != PARSE_OK) {
 			printf("parse error line %llu char %llu (offset %llu)\n",
 			       (unsigned long long) tok_state_line(&ts),
@@ -150,13 +179,31 @@ static eval_err_t readevalfn(memory_state_t *ms, node_t **n, node_t **result, vo
 		}
 		node_handle_update(eval_in_hdl, NULL);
 		node_handle_update(eval_out_hdl, NULL);
+		if(in_region) {
+			memory_region_release(ms);
+			in_region = false;
+		}
+		/* finalizers deferred by the GC run between forms */
+		memory_gc_run_finalizers(ms, 0);
+		/* between top level forms the outer eval() only holds cells in
+		   root slots and locked handles, so cells may move. A nested
+		   call is inside a form, whose caller may hold anything. */
+		if(compact && read_eval_depth == 1
+		   && memory_gc_fragmentation(ms) >= compact) {
+			memory_gc_compact(ms);
+		}
 	}
 
 cleanup:
 
+	if(in_region) {
+		memory_region_release(ms);
+	}
 	node_droproot(eval_in_hdl);
 	node_droproot(eval_out_hdl);
 	node_droproot(env_handle);
+	node_roots_pop(ms, &env_handle, 1);
+	read_eval_depth--;
 	unmap_file(&info);
 
 	return eval_stat;
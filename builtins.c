@@ -210,6 +210,34 @@ eval_err_t foreign_cons(memory_state_t *ms, node_t *args, node_t *env, node_t **
 	return extract_args(ms, 2, do_cons, args, out, NULL);
 }
 
+static
+eval_err_t do_weak(memory_state_t *ms, node_t **args, node_t **out, void *p)
+{
+	(void) p;
+	*out = node_weak_handle_new(ms, args[0]);
+	return EVAL_OK;
+}
+eval_err_t foreign_weak(memory_state_t *ms, node_t *args, node_t *env, node_t **out)
+{
+	return extract_args(ms, 1, do_weak, args, out, NULL);
+}
+
+static
+eval_err_t do_weak_ref(memory_state_t *ms, node_t **args, node_t **out, void *p)
+{
+	(void) p;
+	if(node_type(args[0]) != NODE_WEAK_HANDLE) {
+		*out = args[0];
+		return eval_err(EVAL_ERR_EXPECTED_WEAK);
+	}
+	*out = node_weak_handle(args[0]);
+	return EVAL_OK;
+}
+eval_err_t foreign_weak_ref(memory_state_t *ms, node_t *args, node_t *env, node_t **out)
+{
+	return extract_args(ms, 1, do_weak_ref, args, out, NULL);
+}
+
 static
 eval_err_t do_symeq_p(memory_state_t *ms, node_t **args, node_t **out, void *p)
 {
@@ -20,6 +20,10 @@ eval_err_t foreign_splsym(memory_state_t *ms, node_t *in, node_t *env, node_t **
 /* node, node -> node */
 eval_err_t foreign_cons(memory_state_t *ms, node_t *in, node_t *env, node_t **out);
 
+/* weak handles: node -> weak handle, weak handle -> node (nil once freed) */
+eval_err_t foreign_weak(memory_state_t *ms, node_t *in, node_t *env, node_t **out);
+eval_err_t foreign_weak_ref(memory_state_t *ms, node_t *in, node_t *env, node_t **out);
+
 eval_err_t foreign_smeq_p(memory_state_t *ms, node_t *in, node_t *env, node_t **out);
 
 /* mathops: node, node -> node */
@@ -11,6 +11,8 @@ struct { char *name, *nmemonic; } base_data_names[] = {
 	{ "foreign_makesym",  "makesym" },
 	{ "foreign_splitsym", "splitsym" },
 	{ "foreign_cons",     "cons" },
+	{ "foreign_weak",     "weak" },
+	{ "foreign_weak_ref", "weak-ref" },
 	{ "foreign_symeq_p",  "symeq?" },
 	{ "foreign_eq_p",     "=?" },
 	{ "foreign_lt_p",     "<?" },
@@ -11,12 +11,14 @@
 
 void environ_pushframe(node_t *env_handle)
 {
-	frame_push(env_handle, NULL, NULL, 0);
+	memory_state_t *ms = data_to_memstate(env_handle);
+	node_handle_update(env_handle,
+	                   node_cons_new(ms, NULL, node_handle(env_handle)));
 }
 
 void environ_popframe(node_t *env_handle)
 {
-	frame_pop(env_handle, NULL, 0);
+	node_handle_update(env_handle, node_cons_cdr(node_handle(env_handle)));
 }
 
 void environ_add(node_t *env_handle, node_t *key, node_t *val)
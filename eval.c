@@ -89,8 +89,8 @@ enum local_id {
 
 static value_t locals_state_get(node_t **locals)
 {
-	if(node_handle(locals[LOCAL_ID_STATE])) {
-		return node_value(node_handle(locals[LOCAL_ID_STATE]));
+	if(locals[LOCAL_ID_STATE]) {
+		return node_value(locals[LOCAL_ID_STATE]);
 	} else {
 		return 0;
 	}
@@ -98,14 +98,13 @@ static value_t locals_state_get(node_t **locals)
 
 static void locals_state_set(memory_state_t *s, node_t **locals, value_t v)
 {
-	node_handle_update(locals[LOCAL_ID_STATE],
-	                   node_value_new(s, v));
+	node_root_set(s, &(locals[LOCAL_ID_STATE]), node_value_new(s, v));
 }
 
 static void *locals_restart_get(node_t **locals)
 {
-	if(node_handle(locals[LOCAL_ID_RESTART])) {
-		return node_blob_addr(node_handle(locals[LOCAL_ID_RESTART]));
+	if(locals[LOCAL_ID_RESTART]) {
+		return node_blob_addr(locals[LOCAL_ID_RESTART]);
 	} else {
 		return NULL;
 	}
@@ -113,8 +112,8 @@ static void *locals_restart_get(node_t **locals)
 
 static void locals_restart_set(memory_state_t *s, node_t **locals, void *addr)
 {
-	node_handle_update(locals[LOCAL_ID_RESTART],
-	                   node_blob_new(s, addr, NULL, 0));
+	node_root_set(s, &(locals[LOCAL_ID_RESTART]),
+	              node_blob_new(s, addr, NULL, 0));
 }
 
 eval_err_t eval(
@@ -128,32 +127,32 @@ eval_err_t eval(
 	DBGSTMT(char buf3[21]);
 	eval_err_t status = EVAL_OK;
 
-	/* saved local variables */
+	/* saved local variables, shadow root slots */
 	node_t *locals[LOCAL_ID_MAX] = { NULL };
 	node_t *newvals[LOCAL_ID_MAX] = { NULL };
 
 	/* accessor macros for state held at each eval step */
 	#define _STATE locals_state_get(locals)
 	#define _RESTART locals_restart_get(locals)
-	#define _CURSOR node_handle(locals[LOCAL_ID_CURSOR])
-	#define _NEWARGS_LAST node_handle(locals[LOCAL_ID_NA_LAST])
-	#define _NEWARGS node_handle(locals[LOCAL_ID_NEWARGS])
-	#define _ENV_HDL node_handle(locals[LOCAL_ID_ENV_HDL])
-	#define _FUNC node_handle(locals[LOCAL_ID_FUNC])
-	#define _INPUT node_handle(locals[LOCAL_ID_INPUT])
+	#define _CURSOR locals[LOCAL_ID_CURSOR]
+	#define _NEWARGS_LAST locals[LOCAL_ID_NA_LAST]
+	#define _NEWARGS locals[LOCAL_ID_NEWARGS]
+	#define _ENV_HDL locals[LOCAL_ID_ENV_HDL]
+	#define _FUNC locals[LOCAL_ID_FUNC]
+	#define _INPUT locals[LOCAL_ID_INPUT]
 
 	#define _SET_STATE(x) locals_state_set(ms, locals, (x))
 	#define _SET_RESTART(x) locals_restart_set(ms, locals, (x))
-	#define _SET_CURSOR(x) node_handle_update(locals[LOCAL_ID_CURSOR], (x))
-	#define _SET_NA_LAST(x) node_handle_update(locals[LOCAL_ID_NA_LAST], (x))
-	#define _SET_NEWARGS(x) node_handle_update(locals[LOCAL_ID_NEWARGS], (x))
-	#define _SET_ENV_HDL(x) node_handle_update(locals[LOCAL_ID_ENV_HDL], (x))
-	#define _SET_FUNC(x) node_handle_update(locals[LOCAL_ID_FUNC], (x))
-	#define _SET_INPUT(x) node_handle_update(locals[LOCAL_ID_INPUT], (x))
-
-	/* long-lived local variables */
-	node_t *frame_hdl;
-	node_t *result_handle;
+	#define _SET_CURSOR(x) node_root_set(ms, &(locals[LOCAL_ID_CURSOR]), (x))
+	#define _SET_NA_LAST(x) node_root_set(ms, &(locals[LOCAL_ID_NA_LAST]), (x))
+	#define _SET_NEWARGS(x) node_root_set(ms, &(locals[LOCAL_ID_NEWARGS]), (x))
+	#define _SET_ENV_HDL(x) node_root_set(ms, &(locals[LOCAL_ID_ENV_HDL]), (x))
+	#define _SET_FUNC(x) node_root_set(ms, &(locals[LOCAL_ID_FUNC]), (x))
+	#define _SET_INPUT(x) node_root_set(ms, &(locals[LOCAL_ID_INPUT]), (x))
+
+	/* long-lived local variables, shadow root slots */
+	node_t *frame;
+	node_t *result;
 	size_t bt_depth = 0;
 	size_t env_depth = 0;
 
@@ -173,8 +172,8 @@ eval_err_t eval(
 	/* holds the actual frame variables for current loop through eval() */
 	bzero_custom(newvals, sizeof(newvals));
 
-	frame_hdl = node_lockroot(node_handle_new(ms, NULL));
-	result_handle = node_lockroot(node_handle_new(ms, NULL));
+	node_roots_push(ms, &frame, 1);
+	node_roots_push(ms, &result, 1);
 
 	_SET_INPUT(node_handle(in_handle));
 	_SET_ENV_HDL(env_handle);
@@ -187,6 +186,13 @@ restart:
 	       { node_print_pretty_stream(dbgtrace_getstream(), _INPUT, false); });
 	DBGTRACE(TC_EVAL, "\n");
 
+	/* the heap grew past its hard limit: unwind every frame */
+	if(memory_gc_oom(ms)) {
+		node_root_set(ms, &result, _INPUT);
+		status = eval_err(EVAL_ERR_OUT_OF_MEM);
+		goto node_cons_cleanup;
+	}
+
 	switch(node_type(_INPUT)) {
 	case NODE_UNINITIALIZED:
 	case NODE_HANDLE:
@@ -199,17 +205,18 @@ restart:
 	case NODE_CONTINUATION:
 	case NODE_SPECIAL_FUNC:
 	case NODE_BLOB:
-		node_handle_update(result_handle, _INPUT);
+	case NODE_WEAK_HANDLE:
+		node_root_set(ms, &result, _INPUT);
 		goto finish;
 
 	case NODE_SYMBOL:
 		if(! environ_lookup(_ENV_HDL,
 		                    _INPUT,
 		                    &temp)) {
-			node_handle_update(result_handle, _INPUT);
+			node_root_set(ms, &result, _INPUT);
 			status = eval_err(EVAL_ERR_UNRESOLVED_SYMBOL);
 		} else {
-			node_handle_update(result_handle, temp);
+			node_root_set(ms, &result, temp);
 		}
 		goto finish;
 
@@ -222,7 +229,7 @@ restart:
 	/* (symbol args...) */
 	_args = node_cons_cdr(_INPUT);
 	if(_args && node_type(_args) != NODE_CONS) {
-		node_handle_update(result_handle, _args);
+		node_root_set(ms, &result, _args);
 		status = eval_err(EVAL_ERR_EXPECTED_CONS);
 		goto node_cons_cleanup;
 	}
@@ -231,14 +238,14 @@ restart:
 	_SET_RESTART(&&node_cons_post_eval_func);
 	newvals[LOCAL_ID_ENV_HDL] = _ENV_HDL;
 	newvals[LOCAL_ID_INPUT] = node_cons_car(_INPUT);
-	frame_push(frame_hdl, locals, newvals, LOCAL_ID_MAX);
+	frame_push(ms, &frame, locals, newvals, LOCAL_ID_MAX);
 	bt_depth++;
 	goto restart;
 	node_cons_post_eval_func:
 	if(status != EVAL_OK) {
 		goto node_cons_cleanup;
 	}
-	_SET_FUNC(node_handle(result_handle));
+	_SET_FUNC(result);
 
 	_args = node_cons_cdr(_INPUT); /* restore */
 
@@ -250,7 +257,7 @@ restart:
 			_SET_RESTART(&&node_if_post_eval_test);
 			newvals[LOCAL_ID_ENV_HDL] = _ENV_HDL;
 			newvals[LOCAL_ID_INPUT] = node_cons_car(_args);
-			frame_push(frame_hdl, locals, newvals, LOCAL_ID_MAX);
+			frame_push(ms, &frame, locals, newvals, LOCAL_ID_MAX);
 			bt_depth++;
 			goto restart;
 			node_if_post_eval_test:
@@ -261,20 +268,20 @@ restart:
 			_args =	node_cons_cdr(_INPUT); /* restore */
 
 			/* select which expr to eval based on result */
-			if(node_handle(result_handle) != NULL) {
-				node_handle_update(result_handle, NULL);
+			if(result != NULL) {
+				node_root_set(ms, &result, NULL);
 				_SET_INPUT(node_cons_cdr(_args));
 			} else {
 				temp = node_cons_cdr(_args);
 				if(node_type(temp) != NODE_CONS) {
-					node_handle_update(result_handle, temp);
+					node_root_set(ms, &result, temp);
 					status = eval_err(EVAL_ERR_EXPECTED_CONS);
 					goto node_cons_cleanup;
 				}
 				_SET_INPUT(node_cons_cdr(temp));
 			}
 			if(node_type(_INPUT) != NODE_CONS) {
-				node_handle_update(result_handle, _INPUT);
+				node_root_set(ms, &result, _INPUT);
 				status = eval_err(EVAL_ERR_EXPECTED_CONS);
 				goto node_cons_cleanup;
 			}
@@ -293,29 +300,31 @@ restart:
 			goto restart;
 
 		case SPECIAL_LAMBDA:
-			temp = node_lambda_new(ms, node_handle(_ENV_HDL),
-			                       /* vars */
-			                       node_cons_car(_args), 
-			                       /* expr list */
-			                       node_cons_cdr(_args));
-			node_handle_update(result_handle, temp);
+			/* args are already (vars . expr list) */
+			if(node_type(_args) != NODE_CONS) {
+				node_root_set(ms, &result, _args);
+				status = eval_err(EVAL_ERR_EXPECTED_CONS);
+				goto node_cons_cleanup;
+			}
+			temp = node_lambda_new(ms, node_handle(_ENV_HDL), _args);
+			node_root_set(ms, &result, temp);
 			goto node_cons_cleanup;
 
 		case SPECIAL_QUOTE:
 			if(node_cons_cdr(_args)) {
-				node_handle_update(result_handle, node_cons_cdr(_args));
+				node_root_set(ms, &result, node_cons_cdr(_args));
 				status = eval_err(EVAL_ERR_TOO_MANY_ARGS);
 				goto node_cons_cleanup;
 			}
 			temp = node_cons_car(_args);
-			node_handle_update(result_handle, temp);
+			node_root_set(ms, &result, temp);
 			goto node_cons_cleanup;
 
 		case SPECIAL_MK_CONT:
 			/* generate new cons with first arg as passed func, second arg
 			   as result of node_cont_new(), then do a tail call. */
 			/* TODO: node_cons_car(_args) should be eval'd */
-			temp = node_cons_new(ms, node_cont_new(ms, node_handle(frame_hdl)),
+			temp = node_cons_new(ms, node_cont_new(ms, frame),
 			                     NULL);
 			temp = node_cons_new(ms, node_cons_car(_args), temp);
 			_SET_INPUT(temp);
@@ -328,22 +337,23 @@ restart:
 			/* return the symbol that was added to environment */
 			_SET_CURSOR(node_cons_car(_args));
 			if(node_type(_CURSOR) != NODE_SYMBOL) {
-				node_handle_update(result_handle, _CURSOR);
+				node_root_set(ms, &result, _CURSOR);
 				status = eval_err(EVAL_ERR_EXPECTED_SYMBOL);
 				goto node_cons_cleanup;
 			}
 		
 			/* eval passed value */
 			if(node_type(node_cons_cdr(_args)) != NODE_CONS) {
-				node_handle_update(result_handle, node_cons_cdr(_args));
-				return eval_err(EVAL_ERR_EXPECTED_CONS);
+				node_root_set(ms, &result, node_cons_cdr(_args));
+				status = eval_err(EVAL_ERR_EXPECTED_CONS);
+				goto node_cons_cleanup;
 			}
 
 			/* status = eval_norec(val, env_handle, &newval); */
 			_SET_RESTART(&&node_special_def_set_post_eval_func);
 			newvals[LOCAL_ID_ENV_HDL] = _ENV_HDL;
 			newvals[LOCAL_ID_INPUT] = node_cons_car(node_cons_cdr(_args));
-			frame_push(frame_hdl, locals, newvals, LOCAL_ID_MAX);
+			frame_push(ms, &frame, locals, newvals, LOCAL_ID_MAX);
 			bt_depth++;
 			goto restart;
 			node_special_def_set_post_eval_func:
@@ -352,20 +362,20 @@ restart:
 			}
 		
 			if(node_special_func(_FUNC) == SPECIAL_DEF) {
-				temp = node_handle(result_handle);
+				temp = result;
 				environ_add(_ENV_HDL, _CURSOR, temp);
 			} else {
 				if(!environ_keyval(_ENV_HDL,
 				                   _CURSOR,
 				                   &keyval)) {
-					node_handle_update(result_handle, _CURSOR);
+					node_root_set(ms, &result, _CURSOR);
 					status = eval_err(EVAL_ERR_UNRESOLVED_SYMBOL);
 					goto node_cons_cleanup;
 				}
-				temp = node_handle(result_handle);
+				temp = result;
 				node_cons_patch_cdr(keyval, temp);
 			}
-			node_handle_update(result_handle, _CURSOR);
+			node_root_set(ms, &result, _CURSOR);
 			goto node_cons_cleanup;
 			case SPECIAL_DEFINED:
 			case SPECIAL_EVAL:
@@ -384,7 +394,7 @@ restart:
 		_SET_RESTART(&&node_cons_post_args_eval);
 		newvals[LOCAL_ID_ENV_HDL] = _ENV_HDL;
 		newvals[LOCAL_ID_INPUT] = node_cons_car(_CURSOR);
-		frame_push(frame_hdl, locals, newvals, LOCAL_ID_MAX);
+		frame_push(ms, &frame, locals, newvals, LOCAL_ID_MAX);
 		bt_depth++;
 		goto restart;
 		node_cons_post_args_eval:
@@ -394,7 +404,7 @@ restart:
 			goto node_lambda_cleanup;
 		}
 
-		temp = node_handle(result_handle);
+		temp = result;
 		if(_NEWARGS == NULL) {
 			_SET_NEWARGS(node_cons_new(ms, temp, NULL));
 			_SET_NA_LAST(_NEWARGS);
@@ -414,7 +424,7 @@ restart:
 				if(node_type(temp) == NODE_SYMBOL
 				   && environ_lookup(_ENV_HDL,
 				                     temp, NULL)) {
-					node_handle_update(result_handle, node_value_new(ms, 1));
+					node_root_set(ms, &result, node_value_new(ms, 1));
 				}
 			}
 			goto node_cons_cleanup;
@@ -427,12 +437,12 @@ restart:
 		}
 	case NODE_FOREIGN:
 		status = node_foreign_func(_FUNC)(ms, _NEWARGS, _ENV_HDL, &temp);
-		node_handle_update(result_handle, temp);
+		node_root_set(ms, &result, temp);
 		goto node_cons_cleanup;
 
 	case NODE_CONTINUATION:
-		node_handle_update(frame_hdl, node_cont(_FUNC));
-		node_handle_update(result_handle, node_cons_car(_NEWARGS));
+		node_root_set(ms, &frame, node_cont(_FUNC));
+		node_root_set(ms, &result, node_cons_car(_NEWARGS));
 		goto node_cons_cleanup;
 
 	case NODE_LAMBDA: 
@@ -457,7 +467,7 @@ restart:
 		                     node_lambda_vars(_FUNC),
 		                     _NEWARGS);
 		if(status != EVAL_OK) {
-			node_handle_update(result_handle, _FUNC);
+			node_root_set(ms, &result, _FUNC);
 			goto node_lambda_cleanup;
 		}
 
@@ -487,14 +497,14 @@ restart:
 				_SET_RESTART(&&node_lambda_post_exprs_eval);
 				newvals[LOCAL_ID_ENV_HDL] = _ENV_HDL;
 				newvals[LOCAL_ID_INPUT] = node_cons_car(_CURSOR);
-				frame_push(frame_hdl, locals, newvals, LOCAL_ID_MAX);
+				frame_push(ms, &frame, locals, newvals, LOCAL_ID_MAX);
 				bt_depth++;
 				goto restart;
 				node_lambda_post_exprs_eval:
 				if(status != EVAL_OK) {
 					goto node_lambda_cleanup;
 				}
-				node_handle_update(result_handle, NULL);
+				node_root_set(ms, &result, NULL);
 			}
 		}
 
@@ -504,7 +514,7 @@ restart:
 		break;
 
 	default:
-		node_handle_update(result_handle, _FUNC);
+		node_root_set(ms, &result, _FUNC);
 		status = eval_err(EVAL_ERR_UNKNOWN_FUNCALL);
 		break;
 	}
@@ -526,7 +536,7 @@ finish:
 	}
 
 
-	if(node_handle(frame_hdl)) {
+	if(frame) {
 		_SET_NEWARGS(NULL);
 		_SET_NA_LAST(NULL);
 		if(_STATE & STATE_FLAG_NEW_INPUT) {
@@ -541,23 +551,23 @@ finish:
 		DBGTRACE(TC_EVAL, " ... ");
 		DBGRUN(TC_EVAL, {
 			node_print_pretty_stream(dbgtrace_getstream(), 
-			                         node_handle(result_handle),
+			                         result,
 			                         false);
 		});
 		DBGTRACE(TC_EVAL, "\n");
 
-		frame_pop(frame_hdl, locals, LOCAL_ID_MAX);
+		frame_pop(ms, &frame, locals, LOCAL_ID_MAX);
 		bt_depth--;
 		assert(_RESTART);
 		goto *_RESTART;
 	}
 
 
-	node_handle_update(out_handle, node_handle(result_handle));
-	node_droproot(frame_hdl);
-	node_droproot(result_handle);
+	node_handle_update(out_handle, result);
+	node_roots_pop(ms, &result, 1);
+	node_roots_pop(ms, &frame, 1);
 
-	frame_deinit(locals, LOCAL_ID_MAX);
+	frame_deinit(ms, locals, LOCAL_ID_MAX);
 
 	return status;
 
@@ -30,6 +30,8 @@ DEFINE_FOREIGN_FACTORY(foreign_cdr)
 DEFINE_FOREIGN_FACTORY(foreign_mksym)
 DEFINE_FOREIGN_FACTORY(foreign_splsym)
 DEFINE_FOREIGN_FACTORY(foreign_cons)
+DEFINE_FOREIGN_FACTORY(foreign_weak)
+DEFINE_FOREIGN_FACTORY(foreign_weak_ref)
 DEFINE_FOREIGN_FACTORY(foreign_smeq_p)
 DEFINE_FOREIGN_FACTORY(foreign_eq_p)
 DEFINE_FOREIGN_FACTORY(foreign_lt_p)
@@ -86,6 +88,8 @@ foreign_assoc_t startenv[] = {
 	{ "makesym",  make_foreign_mksym },
 	{ "splitsym", make_foreign_splsym },
 	{ "cons",     make_foreign_cons },
+	{ "weak",     make_foreign_weak },
+	{ "weak-ref", make_foreign_weak_ref },
 
 	{ "symeq?",   make_foreign_smeq_p },
 	{ "eq?",      make_foreign_eq_p },
@@ -123,6 +127,11 @@ int main(int argc, char *argv[])
 	tok_state_t ts;
 	memory_state_t ms;
 	node_t *env_handle;
+	bool region = getenv("EVAL_TEST_REGION") != NULL;
+	/* GC time slice run between arguments, in nanoseconds */
+	unsigned long long slice = getenv("EVAL_TEST_GC_SLICE")
+	                           ? strtoull(getenv("EVAL_TEST_GC_SLICE"), NULL, 0)
+	                           : 0;
 
 	dbgtrace_setstream(g_stream_stdout);
 	dbgtrace_enable( 0
@@ -137,6 +146,9 @@ int main(int argc, char *argv[])
 	               );
 
 	node_memstate_init(&ms, libc_malloc_wrap, libc_free_wrap, NULL);
+	if(getenv("EVAL_TEST_GC_THREAD")) {
+		memory_gc_start_marker(&ms);
+	}
 
 	/* setup environment */
 	eval_in_hdl = node_lockroot(node_handle_new(&ms, NULL));
@@ -149,6 +161,10 @@ int main(int argc, char *argv[])
 
 	/* parse + eval argv */
 	for(i = 1; i < (unsigned) argc; i++) {
+		/* each argument gets its own scratch region */
+		if(region) {
+			memory_region_begin(&ms);
+		}
 		stream = bufstream_init(&bs, argv[i], strlen(argv[i]));
 		tok_state_init(&ts, stream);
 		printf("*** parse %s ***\n", argv[i]);
@@ -159,6 +175,9 @@ int main(int argc, char *argv[])
 			       (unsigned long long) tok_state_linechr(&ts),
 			       (unsigned long long) tok_state_offset(&ts));
 			printf("-- %s\n", parse_err_str(parse_stat));
+			if(region) {
+				memory_region_release(&ms);
+			}
 			continue;
 		}
 
@@ -191,6 +210,16 @@ int main(int argc, char *argv[])
 
 		printf("*** releasing eval result %p ***\n", node_handle(eval_out_hdl));
 		node_handle_update(eval_out_hdl, NULL);
+
+		if(region) {
+			printf("*** releasing scratch region ***\n");
+			memory_region_release(&ms);
+		}
+
+		if(slice) {
+			printf("*** gc slice: %llu iterations ***\n",
+			       (unsigned long long) memory_gc_iterate_n(&ms, 0, slice));
+		}
 	}
 
 	printf("*** result environment %p ***\n", env_handle);
@@ -7,49 +7,51 @@
 #include "frame.h"
 
 void frame_push(
-	node_t *frame_hdl,
+	memory_state_t *ms,
+	node_t **frame,
 	node_t **locals,
 	node_t **newvals,
 	size_t n)
 {
 	ssize_t i;
 	node_t *cursor = NULL;
-	memory_state_t *ms = data_to_memstate(frame_hdl);
 
 	for(i = n - 1; i >= 0; i--) {
-		cursor = node_cons_new(ms, node_handle(locals[i]), cursor);
-		node_handle_update(locals[i], newvals[i]);
+		cursor = node_cons_new(ms, locals[i], cursor);
+		node_root_set(ms, &(locals[i]), newvals[i]);
 	}
-	cursor = node_cons_new(ms, cursor, node_handle(frame_hdl));
-	node_handle_update(frame_hdl, cursor);
+	cursor = node_cons_new(ms, cursor, *frame);
+	node_root_set(ms, frame, cursor);
 }
 
 void frame_pop(
-	node_t *frame_hdl,
+	memory_state_t *ms,
+	node_t **frame,
 	node_t **locals,
 	size_t n)
 {
 	size_t i;
 	node_t *cursor;
 
-	cursor = node_cons_car(node_handle(frame_hdl));
+	cursor = node_cons_car(*frame);
 	for(i = 0; i < n; i++) {
 		assert(cursor);
-		node_handle_update(locals[i], node_cons_car(cursor));
+		node_root_set(ms, &(locals[i]), node_cons_car(cursor));
 		cursor = node_cons_cdr(cursor);
 	}
 
-	node_handle_update(frame_hdl, node_cons_cdr(node_handle(frame_hdl)));
+	node_root_set(ms, frame, node_cons_cdr(*frame));
 }
 
 void frame_restore(
-	node_t *frame_hdl,
+	memory_state_t *ms,
+	node_t **frame,
 	node_t **locals,
 	size_t n,
 	node_t *snapshot)
 {
-	node_handle_update(frame_hdl, snapshot);
-	frame_pop(frame_hdl, locals, n);
+	node_root_set(ms, frame, snapshot);
+	frame_pop(ms, frame, locals, n);
 }
 
 void frame_add_elem(
@@ -116,20 +118,15 @@ void frame_init(
 	node_t **locals_arr,
 	size_t locals_len)
 {
-	size_t i;
-	for(i = 0; i < locals_len; i++) {
-		locals_arr[i] = node_lockroot(node_handle_new(ms, NULL));
-	}
+	node_roots_push(ms, locals_arr, locals_len);
 }
 
 void frame_deinit(
+	memory_state_t *ms,
 	node_t **locals,
 	size_t n)
 {
-	size_t i;
-	for(i = 0; i < n; i++) {
-		node_droproot(locals[i]);
-	}
+	node_roots_pop(ms, locals, n);
 }
 
 static int print_frm_cb(node_t *n, void *p)
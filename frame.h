@@ -5,7 +5,7 @@
 
 /* frame format:
 
-   frame_hdl
+   frame_hdl (or root slot)
    +---+
    |   |
    +---+
@@ -31,19 +31,24 @@
    +---+
 */
 
+/* save the locals in a new frame on top of the one in the frame slot, and
+   set them to newvals. The frame slot and locals are shadow root slots. */
 void frame_push(
-	node_t *frame_hdl,
+	memory_state_t *ms,
+	node_t **frame,
 	node_t **locals,
 	node_t **newvals,
 	size_t n);
 
 void frame_pop(
-	node_t *frame_hdl,
+	memory_state_t *ms,
+	node_t **frame,
 	node_t **locals,
 	size_t n);
 
 void frame_restore(
-	node_t *frame_hdl,
+	memory_state_t *ms,
+	node_t **frame,
 	node_t **locals,
 	size_t n,
 	node_t *snapshot);
@@ -59,13 +64,15 @@ int frame_iterate(
 	bool recursive,
 	frm_cb_t f_cb, void *f_p);
 	
-// set all entries in locals_arr to newly allocated, locked root node handles
+// register all entries in locals_arr as shadow root slots, set to NULL
 void frame_init(
 	memory_state_t *ms,
 	node_t **locals_arr,
 	size_t locals_len);
 
+// unregister them, they must be the last slots registered
 void frame_deinit(
+	memory_state_t *ms,
 	node_t **locals,
 	size_t n);
 
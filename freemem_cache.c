@@ -1,5 +1,7 @@
 #include <stddef.h>
 #include "libc_custom.h"
+#include "traceclass.h"
+#include "dbgtrace.h"
 #include "freemem_cache.h"
 
 fmcache_state_t *fmcache_state_init(
@@ -9,12 +11,18 @@ fmcache_state_t *fmcache_state_init(
 	void *alloc_p)
 {
 	fmcache_state_t *state = (fmcache_state_t *) p;
+	unsigned int i;
 	if(state) {
-		dlist_init(&(state->free_list));
+		for(i = 0; i < FMC_CLASS_COUNT; i++) {
+			dlist_init(&(state->classes[i].free_list));
+			state->classes[i].alloc_count = 0;
+			state->classes[i].free_count = 0;
+		}
 		state->mem_alloc = mem_alloc;
 		state->mem_free = mem_free;
 		state->alloc_p = alloc_p;
 		state->alloc_count = 0;
+		state->free_count = 0;
 	}
 
 	return state;
@@ -32,64 +40,132 @@ static free_mem_cell_t *data_to_fmcell(void *data)
 	return (free_mem_cell_t *) base;
 }
 
+size_t fmcache_class_len(unsigned int cls)
+{
+	return (size_t) FMC_MIN_LEN << cls;
+}
+
+/* smallest class with fmcache_class_len(cls) >= len, or FMC_CLASS_NONE */
+static unsigned int len_to_class(size_t len)
+{
+	unsigned int cls = 0;
+	size_t cls_len = FMC_MIN_LEN;
+
+	while(cls_len < len) {
+		cls_len <<= 1;
+		if(++cls == FMC_CLASS_NONE) {
+			break;
+		}
+	}
+	return cls;
+}
+
 void fmcache_state_reset(fmcache_state_t * state)
 {
 	dlnode_t *n;
-	while(! dlist_is_empty(&(state->free_list))) {
-		n = dlnode_remove(dlist_first(&(state->free_list)));
-		free(n);
+	unsigned int i;
+	fmcache_class_t *c;
+
+	for(i = 0; i < FMC_CLASS_COUNT; i++) {
+		c = &(state->classes[i]);
+		while(! dlist_is_empty(&(c->free_list))) {
+			n = dlnode_remove(dlist_first(&(c->free_list)));
+			state->mem_free(hdr_to_fmcell(n), state->alloc_p);
+		}
+		c->alloc_count = 0;
+		c->free_count = 0;
 	}
 	state->alloc_count = 0;
+	state->free_count = 0;
 }
 
 void *fmcache_request(size_t len, void *fmcache_state)
 {
-	/* find a memory allocation that is large enough to hold len */
-	dlnode_t *cursor;
+	/* pop the free list of the size class that holds len */
 	free_mem_cell_t *fmc;
+	fmcache_class_t *c = NULL;
 	fmcache_state_t *state = (fmcache_state_t *)fmcache_state;
+	unsigned int cls = len_to_class(len);
+	size_t alloc_len = len;
+	DBGSTMT(char buf[21]);
+	DBGSTMT(char buf2[21]);
+	DBGSTMT(char buf3[21]);
 
-	for(cursor = dlist_first(&(state->free_list));
-	    ! dlnode_is_terminal(cursor);
-	    cursor = dlnode_next(cursor)) {
-		fmc = hdr_to_fmcell(cursor);
-		if(fmc->len >= len) {
-#if defined(FMC_ALLOC_DEBUG)
-		printf("fm_cache: reuse node 0x%p (data@0x%p) nfree=%llu\n",
-		       fmc, &(fmc->u.data[0]), (unsigned long long) s->total_free);
-#endif
-			dlnode_remove(cursor);
+	if(cls != FMC_CLASS_NONE) {
+		c = &(state->classes[cls]);
+		if(! dlist_is_empty(&(c->free_list))) {
+			fmc = hdr_to_fmcell(dlnode_remove(dlist_first(&(c->free_list))));
+			c->free_count--;
 			state->free_count--;
+			DBGTRACELN(TC_FMC_ALLOC,
+			           "fm_cache: reuse node ", fmt_ptr(buf, fmc), " ",
+			           "class=", fmt_u64d(buf2, cls), " ",
+			           "nfree=", fmt_u64d(buf3, c->free_count));
 			return (void *) &(fmc->u.data[0]);
 		}
+		alloc_len = fmcache_class_len(cls);
+	}
+
+	fmc = state->mem_alloc(alloc_len + offsetof(free_mem_cell_t, u),
+	                       state->alloc_p);
+	if(! fmc) {
+		return NULL;
 	}
-#if defined(FMC_ALLOC_DEBUG)
-	printf("fm_cache: malloc node %p (%p) nalloc=%llu\n",
-	       fmc, &(fmc->u.data[0]), (unsigned long long) s->total_alloc);
-#endif
-	fmc = malloc(len + offsetof(free_mem_cell_t, u));
-	if(fmc) {
-		fmc->len = len;
-		state->alloc_count++;
-		return (void *) &(fmc->u.data[0]);
+	fmc->cls = cls;
+	state->alloc_count++;
+	if(c) {
+		c->alloc_count++;
 	}
-	return NULL;
+	DBGTRACELN(TC_FMC_ALLOC,
+	           "fm_cache: malloc node ", fmt_ptr(buf, fmc), " ",
+	           "class=", fmt_u64d(buf2, cls), " ",
+	           "nalloc=", fmt_u64d(buf3, state->alloc_count));
+	return (void *) &(fmc->u.data[0]);
 }
 
 void fmcache_return(void *data, void *fmcache_state)
 {
 	free_mem_cell_t *fmc = data_to_fmcell(data);
 	fmcache_state_t *state = (fmcache_state_t *)fmcache_state;
+	fmcache_class_t *c;
+	DBGSTMT(char buf[21]);
+	DBGSTMT(char buf2[21]);
+	DBGSTMT(char buf3[21]);
+
+	if(fmc->cls == FMC_CLASS_NONE) {
+		/* too big to cache */
+		state->alloc_count--;
+		state->mem_free(fmc, state->alloc_p);
+		return;
+	}
+
+	c = &(state->classes[fmc->cls]);
 	dlnode_init(&(fmc->u.hdr));
-	dlist_insertfirst(&(state->free_list), &(fmc->u.hdr));
+	dlist_insertfirst(&(c->free_list), &(fmc->u.hdr));
+	c->free_count++;
 	state->free_count++;
-#if defined(FMC_ALLOC_DEBUG)
-	printf("fm_cache: return node %p (%p) nfree=%llu\n",
-	       fmc, &(fmc->u.data[0]), (unsigned long long) s->total_free);
-#endif
+	DBGTRACELN(TC_FMC_ALLOC,
+	           "fm_cache: return node ", fmt_ptr(buf, fmc), " ",
+	           "class=", fmt_u64d(buf2, fmc->cls), " ",
+	           "nfree=", fmt_u64d(buf3, c->free_count));
 }
 
 uintptr_t fmcache_count(fmcache_state_t *state)
 {
 	return state->alloc_count;
 }
+
+uintptr_t fmcache_count_class(fmcache_state_t *state, unsigned int cls)
+{
+	return cls < FMC_CLASS_COUNT ? state->classes[cls].alloc_count : 0;
+}
+
+uintptr_t fmcache_count_free(fmcache_state_t *state)
+{
+	return state->free_count;
+}
+
+uintptr_t fmcache_count_class_free(fmcache_state_t *state, unsigned int cls)
+{
+	return cls < FMC_CLASS_COUNT ? state->classes[cls].free_count : 0;
+}
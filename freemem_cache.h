@@ -1,12 +1,22 @@
 #if ! defined(FREEMEM_CACHE_H)
-#define MEMALLOC_H
+#define FREEMEM_CACHE_H
+
+#include <stdint.h>
 
 #include "dlist.h"
 
 #include "allocator_def.h"
 
+/* requests are rounded up to a power of two size class of at least
+   FMC_MIN_LEN bytes; requests larger than the biggest class bypass the
+   cache */
+#define FMC_MIN_SHIFT 4
+#define FMC_MIN_LEN (1 << FMC_MIN_SHIFT)
+#define FMC_CLASS_COUNT 12
+#define FMC_CLASS_NONE FMC_CLASS_COUNT
+
 typedef struct {
-	size_t len;
+	size_t cls;
 	union {
 		dlnode_t hdr;
 		int data[0];
@@ -15,6 +25,12 @@ typedef struct {
 
 typedef struct {
 	dlist_t free_list;
+	uintptr_t alloc_count;
+	uintptr_t free_count;
+} fmcache_class_t;
+
+typedef struct {
+	fmcache_class_t classes[FMC_CLASS_COUNT];
 	mem_allocator_fn_t mem_alloc;
 	mem_free_fn_t mem_free;
 	void *alloc_p;
@@ -33,6 +49,14 @@ void fmcache_state_reset(fmcache_state_t *state);
 void *fmcache_request( size_t len, void *fmcache_state);
 void fmcache_return(void *p, void *fmcache_state);
 
+/* largest request served by size class cls */
+size_t fmcache_class_len(unsigned int cls);
+
+/* allocations made from the backing allocator, in total or per class */
 uintptr_t fmcache_count(fmcache_state_t *state);
+uintptr_t fmcache_count_class(fmcache_state_t *state, unsigned int cls);
+/* allocations currently waiting in the cache, in total or per class */
+uintptr_t fmcache_count_free(fmcache_state_t *state);
+uintptr_t fmcache_count_class_free(fmcache_state_t *state, unsigned int cls);
 
 #endif
@@ -0,0 +1,196 @@
+#define _POSIX_C_SOURCE 199309L /* clock_gettime() under --std=c99 */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+#include "memory.h"
+#include "node.h"
+#include "malloc_wrapper.h"
+#include "mmap_arena.h"
+
+/* times full GC cycles run by memory_gc_cycle_parallel() with 1 to N
+   threads, against memory_gc_cycle(). Each timed cycle traces a live binary
+   tree of cons cells and frees a garbage tree of the same size, kept
+   unreachable by a link back to its root.
+
+   With GC_BENCH_LIST=N it instead times memory_gc_cycle() over a live list
+   of N conses linked in a random order, so the trace jumps all over the
+   heap, with the nursery off. GC_BENCH_HUGEPAGES and GC_BENCH_PREFAULT take the slabs from an
+   mmap()ed arena with those options, as PAREN_HUGEPAGES and PAREN_PREFAULT
+   do for paren. */
+
+#if ! defined(GC_BENCH_RUNS)
+#define GC_BENCH_RUNS 4
+#endif
+
+static double now(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static node_t *tree(memory_state_t *s, unsigned int depth)
+{
+	if(! depth) {
+		return node_value_new(s, depth);
+	}
+	return node_cons_new(s, tree(s, depth - 1), tree(s, depth - 1));
+}
+
+/* one cycle after the garbage was made, with the given number of threads
+   (0 for memory_gc_cycle()), returns seconds */
+static double run(memory_state_t *s, node_t *hdl, unsigned int depth,
+                  unsigned int nthreads)
+{
+	node_t *root, *leaf;
+	double start;
+
+	memory_gc_cycle_parallel(s, nthreads);
+
+	node_handle_update(hdl, tree(s, depth));
+	root = node_handle(hdl);
+	for(leaf = root; node_type(node_cons_car(leaf)) == NODE_CONS; ) {
+		leaf = node_cons_car(leaf);
+	}
+	node_cons_patch_car(leaf, root);
+	/* promoted cells survive the cycle in progress */
+	memory_gc_minor(s);
+	node_handle_update(hdl, NULL);
+	memory_gc_cycle_parallel(s, nthreads);
+
+	start = now();
+	memory_gc_cycle_parallel(s, nthreads);
+	return now() - start;
+}
+
+/* a live list of len conses in a random heap order, then GC_BENCH_RUNS
+   timed cycles over it, each made to run by a cell of garbage */
+static void run_list(memory_state_t *s, node_t *hdl, node_t *garbage,
+                     unsigned long len)
+{
+	node_t **cells;
+	node_t *tmp;
+	unsigned long i, j;
+	unsigned int run;
+	double t, best = 0, sum = 0;
+
+	cells = malloc(len * sizeof(*cells));
+	if(! cells) {
+		printf("can't allocate %lu cell pointers\n", len);
+		return;
+	}
+	for(i = 0; i < len; i++) {
+		cells[i] = node_cons_new(s, node_value_new(s, i), NULL);
+	}
+	srand(1);
+	for(i = len - 1; i > 0; i--) {
+		j = ((unsigned long) rand() * ((unsigned long) RAND_MAX + 1) + rand())
+		    % (i + 1);
+		tmp = cells[i];
+		cells[i] = cells[j];
+		cells[j] = tmp;
+	}
+	for(i = 0; i + 1 < len; i++) {
+		node_cons_patch_cdr(cells[i], cells[i + 1]);
+	}
+	node_handle_update(hdl, cells[0]);
+	free(cells);
+	memory_gc_minor(s);
+	memory_gc_cycle(s);
+
+	printf("live cells: %lu\n", 2 * len);
+	for(run = 0; run < GC_BENCH_RUNS; run++) {
+		node_handle_update(garbage, node_value_new(s, run));
+		node_handle_update(garbage, NULL);
+		t = now();
+		memory_gc_cycle(s);
+		t = now() - t;
+		printf("memory_gc_cycle: %.3fs\n", t);
+		if(! run || t < best) {
+			best = t;
+		}
+		sum += t;
+	}
+	printf("best %.3fs mean %.3fs\n", best, sum / GC_BENCH_RUNS);
+	node_handle_update(hdl, NULL);
+}
+
+int main(int argc, char *argv[])
+{
+	memory_state_t ms;
+	mmarena_state_t arena;
+	unsigned int arena_flags = 0;
+	node_t *live, *garbage;
+	unsigned int depth = 20, nthreads, max_threads;
+	unsigned long list_len = 0;
+	double t, base;
+
+	if(argc > 3) {
+		printf("usage: %s [depth [max threads]]\n", argv[0]);
+		return -1;
+	}
+	if(argc > 1) {
+		depth = strtoul(argv[1], NULL, 0);
+	}
+	max_threads = sysconf(_SC_NPROCESSORS_ONLN);
+	if(argc > 2) {
+		max_threads = strtoul(argv[2], NULL, 0);
+	}
+
+	if(getenv("GC_BENCH_LIST")) {
+		list_len = strtoul(getenv("GC_BENCH_LIST"), NULL, 0);
+	}
+	if(getenv("GC_BENCH_HUGEPAGES")) {
+		arena_flags |= MMARENA_HUGEPAGE;
+	}
+	if(getenv("GC_BENCH_PREFAULT")) {
+		arena_flags |= MMARENA_PREFAULT;
+	}
+	if(arena_flags) {
+		mmarena_state_init(&arena, MEMORY_SLAB_LEN, 0, arena_flags,
+		                   libc_malloc_wrap, libc_free_wrap, NULL);
+		node_memstate_init(&ms, mmarena_request, mmarena_return, &arena);
+	} else {
+		node_memstate_init(&ms, libc_malloc_wrap, libc_free_wrap, NULL);
+	}
+	/* only the cycles run here collect */
+	memory_gc_set_pace(&ms, 0);
+
+	live = node_lockroot(node_handle_new(&ms, NULL));
+	garbage = node_lockroot(node_handle_new(&ms, NULL));
+	if(list_len) {
+		memory_gc_set_nursery(&ms, 0);
+		run_list(&ms, live, garbage, list_len);
+		goto out;
+	}
+	node_handle_update(live, tree(&ms, depth));
+	memory_gc_minor(&ms);
+
+	printf("live cells: %lu, garbage cells: %lu per cycle\n",
+	       (2UL << depth) - 1, (2UL << depth) - 1);
+	base = run(&ms, garbage, depth, 0);
+	printf("memory_gc_cycle: %.3fs\n", base);
+	for(nthreads = 1; nthreads <= max_threads; nthreads++) {
+		t = run(&ms, garbage, depth, nthreads);
+		printf("threads %2u: %.3fs speedup %.2f\n", nthreads, t, base / t);
+	}
+
+out:
+	node_droproot(garbage);
+	node_droproot(live);
+	memory_gc_cycle_parallel(&ms, max_threads);
+	memory_gc_cycle_parallel(&ms, max_threads);
+	if(memory_gc_count_total(&ms) != memory_gc_count_free(&ms)) {
+		printf("warning: %llu allocations remain at exit!\n",
+		       (unsigned long long) (memory_gc_count_total(&ms)
+		                             - memory_gc_count_free(&ms)));
+	}
+	memory_state_reset(&ms);
+	if(arena_flags) {
+		mmarena_state_reset(&arena);
+	}
+	return 0;
+}
@@ -1,7 +1,17 @@
+#define _POSIX_C_SOURCE 199309L /* clock_gettime() under --std=c99 */
+#define _DEFAULT_SOURCE /* MAP_ANONYMOUS under --std=c99 */
+
 #include <stddef.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <assert.h>
 #include <string.h>
+#include <time.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#if defined(GC_PARALLEL_CYCLE)
+#include <sched.h>
+#endif /* defined(GC_PARALLEL_CYCLE) */
 
 #include "stream.h"
 #include "libc_custom.h"
@@ -10,11 +20,26 @@
 
 #include "memory.h"
 
+/* GC_INLINE_LINKS specializes the GC for the node layer: the links of a cell
+   are enumerated in place and each one handed straight to the action, where
+   otherwise both go through function pointers (the data link callback, and
+   the action it is given) */
+#if defined(GC_INLINE_LINKS)
+#include "node_links.h"
+#define MEMSTATE_LINKS(S, CB, DATA, P) NODE_FOR_EACH_LINK(DATA, CB, P)
+#else
+#define MEMSTATE_LINKS(S, CB, DATA, P) (S)->dl_cb(CB, DATA, P)
+#endif /* defined(GC_INLINE_LINKS) */
+
+#if ! defined(MAP_ANONYMOUS)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
 #define MS_FLAG_ACTIVE 0x1
 
 void memstate_print(memory_state_t *state, stream_t *s)
 {
-	char b[17], b2[17];
+	char b[17], b2[21];
 	stream_putln(s, "memstate @ 0x", fmt_ptr(b, state), ":");
 	stream_putln(s, "total_alloc=", fmt_s64(b2, state->total_alloc));
 #if ! defined(NO_GC_FREELIST)
@@ -26,662 +51,4321 @@ void memstate_print(memory_state_t *state, stream_t *s)
 	stream_putln(s, "skipped_clean_iters=",
 	                fmt_s64(b2, state->skipped_clean_iters));
 #if ! defined(NO_GC_FREELIST)
-	stream_putln(s, "free list @ 0x", fmt_ptr(b, &(state->free_list)));
+	stream_putln(s, "classes @ 0x", fmt_ptr(b, state->classes));
+	stream_putln(s, "slab_list @ 0x", fmt_ptr(b, &(state->slab_list)));
+	stream_putln(s, "slab_count=", fmt_s64(b2, state->slab_count));
+	stream_putln(s, "slab_empty=", fmt_s64(b2, state->slab_empty));
+	stream_putln(s, "released_slabs=", fmt_s64(b2, state->released_slabs));
+	stream_putln(s, "released_cells=", fmt_s64(b2, state->released_cells));
+	stream_putln(s, "region_freed=", fmt_s64(b2, state->region_freed));
+	stream_putln(s, "compacted_cells=", fmt_s64(b2, state->compacted_cells));
 #endif
 	stream_putln(s, "root sentinel @ 0x", fmt_ptr(b, &(state->root_sentinel)));
 	stream_putln(s, "roots_list @ 0x", fmt_ptr(b, &(state->roots_list)));
-	stream_putln(s, "boundary_list @ 0x", fmt_ptr(b, &(state->boundary_list)));
+	stream_putln(s, "worklist @ 0x", fmt_ptr(b, state->worklist));
 	stream_putln(s, "free_pending_list @ 0x",
 	                fmt_ptr(b, &(state->free_pending_list)));
-	stream_putln(s, "white_list @ 0x", fmt_ptr(b, &(state->white_list)));
-	stream_putln(s, "black_list @ 0x", fmt_ptr(b, &(state->black_list)));
-	stream_putln(s, "reachable_listref: 0x",
-	                fmt_ptr(b, state->reachable_listref));
-	stream_putln(s, "unproc_listref: 0x", fmt_ptr(b, state->unproc_listref));
+#if defined(NO_GC_FREELIST)
+	stream_putln(s, "heap_list @ 0x", fmt_ptr(b, &(state->heap_list)));
+#endif /* defined(NO_GC_FREELIST) */
+	stream_putln(s, "doomed_list @ 0x", fmt_ptr(b, &(state->doomed_list)));
+	stream_putln(s, "finalize_list @ 0x", fmt_ptr(b, &(state->finalize_list)));
+	stream_putln(s, "finalize_len=", fmt_s64(b2, state->finalize_len));
+	stream_putln(s, "finalized_count=", fmt_s64(b2, state->finalized_count));
+	stream_putln(s, "defer_fin=", fmt_s64(b2, state->ms_flags.defer_fin));
+	stream_putln(s, "nursery_list @ 0x", fmt_ptr(b, &(state->nursery_list)));
+	stream_putln(s, "nursery_count=", fmt_s64(b2, state->nursery_count));
+	stream_putln(s, "nursery_len=", fmt_s64(b2, state->nursery_len));
+	stream_putln(s, "minor_count=", fmt_s64(b2, state->minor_count));
+	stream_putln(s, "promoted_count=", fmt_s64(b2, state->promoted_count));
+	stream_putln(s, "young_free_count=", fmt_s64(b2, state->young_free_count));
+	stream_putln(s, "heap_len=", fmt_s64(b2, state->heap_len));
+	stream_putln(s, "soft_limit=", fmt_s64(b2, state->soft_limit));
+	stream_putln(s, "hard_limit=", fmt_s64(b2, state->hard_limit));
+	stream_putln(s, "pressure_count=", fmt_s64(b2, state->pressure_count));
+	stream_putln(s, "gc_pace=", fmt_s64(b2, state->gc_pace));
+	stream_putln(s, "gc_debt=", fmt_s64(b2, state->gc_debt));
+	stream_putln(s, "paced_iters=", fmt_s64(b2, state->paced_iters));
+	stream_putln(s, "paced_cycles=", fmt_s64(b2, state->paced_cycles));
+	stream_putln(s, "adaptive=", fmt_s64(b2, state->ms_flags.adaptive));
+	stream_putln(s, "adapt_requested=", fmt_s64(b2, state->adapt_requested));
+	stream_putln(s, "adapt_steps=", fmt_s64(b2, state->adapt_steps));
+	stream_putln(s, "adapt_budget=", fmt_s64(b2, state->adapt_budget));
+	stream_putln(s, "adapt_count=", fmt_s64(b2, state->adapt_count));
+#if defined(GC_DEFERRED_RC)
+	stream_putln(s, "rc_log_count=", fmt_s64(b2, state->rc_log_count));
+#endif /* defined(GC_DEFERRED_RC) */
+	stream_putln(s, "weak_table @ 0x", fmt_ptr(b, state->weak_table));
+	stream_putln(s, "weak_len=", fmt_s64(b2, state->weak_len));
+	stream_putln(s, "weak_count=", fmt_s64(b2, state->weak_count));
+	stream_putln(s, "weak_cleared=", fmt_s64(b2, state->weak_cleared));
+	stream_putln(s, "shadow @ 0x", fmt_ptr(b, state->shadow));
+	stream_putln(s, "shadow_len=", fmt_s64(b2, state->shadow_len));
+	stream_putln(s, "shadow_scanned=",
+	                fmt_s64(b2, state->ms_flags.shadow_scanned));
+	stream_putln(s, "large_list @ 0x", fmt_ptr(b, &(state->large_list)));
+	stream_putln(s, "large_len=", fmt_s64(b2, state->large_len));
+#if defined(GC_CYCLE_COLLECT)
+	stream_putln(s, "cycle_log_count=", fmt_s64(b2, state->cycle_log_count));
+#endif /* defined(GC_CYCLE_COLLECT) */
+	stream_putln(s, "trial_passes=", fmt_s64(b2, state->trial_passes));
+	stream_putln(s, "trial_freed=", fmt_s64(b2, state->trial_freed));
+	stream_putln(s, "rc_advised=", fmt_s64(b2, state->rc_advised));
+	stream_putln(s, "rc_applied=", fmt_s64(b2, state->rc_applied));
+	stream_putln(s, "oom=", fmt_s64(b2, state->ms_flags.oom));
+	stream_putln(s, "region=", fmt_s64(b2, state->ms_flags.region));
+	stream_putln(s, "mark_epoch=", fmt_s64(b2, state->mark_epoch));
+	stream_putln(s, "worklist_len=", fmt_s64(b2, state->worklist_len));
+	stream_putln(s, "sweeping=", fmt_s64(b2, state->ms_flags.sweeping));
 	stream_putln(s, "init callback: 0x", fmt_ptr(b, state->i_cb));
 	stream_putln(s, "data_link_callback: 0x", fmt_ptr(b, state->dl_cb));
+	stream_putln(s, "relocate_callback: 0x", fmt_ptr(b, state->r_cb));
 	stream_putln(s, "print_callback: 0x", fmt_ptr(b, state->p_cb));
 }
 
+static
+void mclist_init(mclink_t *l)
+{
+	l->prev = l->next = l;
+}
+
+static inline
+bool mclist_is_empty(mclink_t *l)
+{
+	return l->next == l;
+}
+
+static inline
+mclink_t *mclist_first(mclink_t *l)
+{
+	return l->next;
+}
+
+static inline
+void mclink_insert(mclink_t *prev, mclink_t *n, mclink_t *next)
+{
+	n->prev = prev;
+	n->next = next;
+	prev->next = n;
+	next->prev = n;
+}
+
+static inline
+mclink_t *mclink_remove(mclink_t *n)
+{
+	n->prev->next = n->next;
+	n->next->prev = n->prev;
+	n->prev = n->next = n;
+	return n;
+}
+
+static inline
+void mclist_insertlast(mclink_t *l, mclink_t *n)
+{
+	mclink_insert(l->prev, n, l);
+}
+
+#if defined(GC_PARALLEL_CYCLE)
+/* move every link of src to the end of l */
+static inline
+void mclist_append(mclink_t *l, mclink_t *src)
+{
+	if(mclist_is_empty(src)) {
+		return;
+	}
+	src->next->prev = l->prev;
+	l->prev->next = src->next;
+	src->prev->next = l;
+	l->prev = src->prev;
+	mclist_init(src);
+}
+#endif /* defined(GC_PARALLEL_CYCLE) */
+
+#define MCLIST_FOR_FWD(LISTPTR, CURS) \
+	for(CURS = mclist_first(LISTPTR); \
+	    CURS != (LISTPTR); \
+	    CURS = CURS->next)
+
 static
 memcell_t *data_to_memcell(void *data)
 {
 	return (memcell_t *) (data - offsetof(memcell_t, data));
 }
 
+/* the marker thread of GC_CONCURRENT_MARK reads the meta and rc_flags of
+   the cells it traces while the mutator changes them, so both are only
+   accessed through MC_GET() and MC_SET(), which are atomic there. Only the
+   mutator writes them, so a load and a store make an update. The store
+   releases what the mutator wrote to the cell before to a marker reading
+   the list bits. */
+#if defined(GC_CONCURRENT_MARK)
+#define MC_GET(FIELD) __atomic_load_n(&(FIELD), __ATOMIC_RELAXED)
+#define MC_SET(FIELD, VAL) __atomic_store_n(&(FIELD), (VAL), __ATOMIC_RELEASE)
+#else
+#define MC_GET(FIELD) (FIELD)
+#define MC_SET(FIELD, VAL) ((FIELD) = (VAL))
+#endif /* defined(GC_CONCURRENT_MARK) */
+
+static
+void memcell_meta_set(memcell_t *mc, uint32_t bits)
+{
+	MC_SET(mc->meta, MC_GET(mc->meta) | bits);
+}
+
+static
+void memcell_meta_clear(memcell_t *mc, uint32_t bits)
+{
+	MC_SET(mc->meta, MC_GET(mc->meta) & ~bits);
+}
+
+static
+void memcell_flags_set(memcell_t *mc, uint32_t flags)
+{
+	MC_SET(mc->rc_flags, MC_GET(mc->rc_flags) | flags);
+}
+
+static
+void memcell_flags_clear(memcell_t *mc, uint32_t flags)
+{
+	MC_SET(mc->rc_flags, MC_GET(mc->rc_flags) & ~flags);
+}
+
+static
+memslab_t *memcell_slab(memcell_t *mc)
+{
+	return (memslab_t *) ((char *) mc
+	                      - (MC_GET(mc->meta) >> MC_OFF_SHIFT)
+	                        * MC_OFF_GRANULE);
+}
+
+static
+void memcell_set_slab(memcell_t *mc, memslab_t *slab)
+{
+	uintptr_t off = (char *) mc - (char *) slab;
+	assert(! (off % MC_OFF_GRANULE));
+	MC_SET(mc->meta, (uint32_t) (off / MC_OFF_GRANULE) << MC_OFF_SHIFT);
+}
+
+static
+unsigned int memcell_list(memcell_t *mc)
+{
+	return MC_GET(mc->meta) & MC_LIST_MASK;
+}
+
+static
+void memcell_set_list(memcell_t *mc, unsigned int list)
+{
+	MC_SET(mc->meta, (MC_GET(mc->meta) & ~(uint32_t) MC_LIST_MASK) | list);
+}
+
+static
+unsigned int memcell_fin_index(memcell_t *mc)
+{
+	return (MC_GET(mc->meta) & MC_FIN_MASK) >> MC_FIN_SHIFT;
+}
+
+/* the slab counts the cells with a finalizer, for memory_state_reset() */
+static
+void memcell_set_fin_index(memcell_t *mc, unsigned int idx)
+{
+	if(! memcell_fin_index(mc) != ! idx) {
+		memcell_slab(mc)->nfin += idx ? 1 : -1;
+	}
+	MC_SET(mc->meta,
+	       (MC_GET(mc->meta) & ~(uint32_t) MC_FIN_MASK) | (idx << MC_FIN_SHIFT));
+}
+
+
 static
 uintptr_t memcell_refcount(memcell_t *mc)
 {
-	return mc->refcount;
+	return MC_GET(mc->rc_flags) >> MC_RC_SHIFT;
 }
 
+/* a saturated count has lost track of its links, so it stays put */
 static
 void memcell_incref(memcell_t *mc)
 {
-	mc->refcount++;
+	if(memcell_refcount(mc) < MC_RC_MAX) {
+		MC_SET(mc->rc_flags, MC_GET(mc->rc_flags) + MC_RC_ONE);
+	}
 }
 
 static
 void memcell_decref(memcell_t *mc)
 {
-	mc->refcount--;
+	if(memcell_refcount(mc) < MC_RC_MAX) {
+		MC_SET(mc->rc_flags, MC_GET(mc->rc_flags) - MC_RC_ONE);
+	}
 }
 
 static
 void memcell_resetref(memcell_t *mc)
 {
-	mc->refcount = 0;
+	MC_SET(mc->rc_flags, MC_GET(mc->rc_flags) & (MC_RC_ONE - 1));
 }
 
 static
 bool memcell_locked(memcell_t *mc)
 {
-	return mc->mc_flags.locked;
+	return MC_GET(mc->rc_flags) & MC_FLAG_LOCKED;
 }
 
 static
 void memcell_lock(memcell_t *mc)
 {
-	mc->mc_flags.locked = true;
+	memcell_flags_set(mc, MC_FLAG_LOCKED);
 }
 
 static
 void memcell_unlock(memcell_t *mc)
 {
-	mc->mc_flags.locked = false;
+	memcell_flags_clear(mc, MC_FLAG_LOCKED);
+}
+
+static
+bool memcell_live(memcell_t *mc)
+{
+	return MC_GET(mc->rc_flags) & MC_FLAG_LIVE;
+}
+
+static
+bool memcell_is_young(memcell_t *mc)
+{
+	return memcell_list(mc) == MC_LIST_NURSERY;
 }
 
+/* young cells are unlocked roots until promoted */
 static
 bool memcell_is_root(memory_state_t *s, memcell_t *mc)
 {
-	return dlnode_owner(&(mc->hdr)) == &(s->roots_list);
+	(void) s;
+	return memcell_list(mc) == MC_LIST_ROOT || memcell_is_young(mc);
 }
 
 static
 bool memcell_is_free(memory_state_t *s, memcell_t *mc)
 {
+	(void) s;
 #if ! defined(NO_GC_FREELIST)
-	assert(mc->mc_flags.live == (dlnode_owner(&(mc->hdr)) != &(s->free_list)));
+	assert(memcell_live(mc) == (memcell_list(mc) != MC_LIST_FREE));
 #endif /* ! defined(NO_GC_FREELIST) */
-	return ! mc->mc_flags.live;
+	return ! memcell_live(mc);
 }
 
 static
 bool memcell_is_free_pending(memory_state_t *s, memcell_t *mc)
 {
-	return dlnode_owner(&(mc->hdr)) == &(s->free_pending_list);
+	(void) s;
+	return memcell_list(mc) == MC_LIST_FREE_PENDING;
 }
 
+#if ! defined(GC_CONCURRENT_MARK)
 static
-bool memcell_is_unproc(memory_state_t *s, memcell_t *mc)
+bool memcell_marked(memory_state_t *s, memcell_t *mc)
 {
-	return dlnode_owner(&(mc->hdr)) == s->unproc_listref;
+	return ((mc->meta & MC_MARK_BIT) >> MC_MARK_SHIFT) == s->mark_epoch;
 }
 
+/* returns true if mc was not marked yet */
 static
-void memcell_to_roots_unproc(memory_state_t *s, memcell_t *mc)
+bool memcell_mark(memory_state_t *s, memcell_t *mc)
 {
-	assert(&(mc->hdr) != &(s->root_sentinel));
-	dlnode_insertprev(&(s->root_sentinel), &(mc->hdr));
-}
+	bool marked = memcell_marked(s, mc);
 
+	mc->meta = (mc->meta & ~(uint32_t) MC_MARK_BIT)
+	           | (s->mark_epoch << MC_MARK_SHIFT);
+	return ! marked;
+}
+#else /* defined(GC_CONCURRENT_MARK) */
 static
-void memcell_to_roots_proc(memory_state_t *s, memcell_t *mc)
+uint64_t *memcell_mark_word(memcell_t *mc, uint64_t *bit)
 {
-	assert(&(mc->hdr) != &(s->root_sentinel));
-	dlnode_insertnext(&(s->root_sentinel), &(mc->hdr));
+	memslab_t *slab = memcell_slab(mc);
+	uintptr_t i = ((char *) mc - (char *) slab->cells) / MEMORY_MARK_GRANULE;
+
+	*bit = (uint64_t) 1 << (i % 64);
+	return &(slab->marks[i / 64]);
 }
 
 static
-void memcell_to_boundary(memory_state_t *s, memcell_t *mc)
+bool memcell_marked(memory_state_t *s, memcell_t *mc)
 {
-	dlist_insertlast(&(s->boundary_list), &(mc->hdr));
+	uint64_t bit, *word = memcell_mark_word(mc, &bit);
+
+	(void) s;
+	return __atomic_load_n(word, __ATOMIC_RELAXED) & bit;
 }
 
+/* returns true if mc was not marked yet: when the marker thread and the
+   mutator race to mark a cell, only one of them gets true */
 static
-void memcell_to_free_pending(memory_state_t *s, memcell_t *mc)
+bool memcell_mark(memory_state_t *s, memcell_t *mc)
 {
-	dlist_insertlast(&(s->free_pending_list), &(mc->hdr));
+	uint64_t bit, *word = memcell_mark_word(mc, &bit);
+
+	(void) s;
+	return ! (__atomic_fetch_or(word, bit, __ATOMIC_RELAXED) & bit);
 }
+#endif /* ! defined(GC_CONCURRENT_MARK) */
 
+#if defined(GC_PARALLEL_CYCLE)
+/* memcell_mark() for several threads marking at once */
 static
-void memcell_deinit(memory_state_t *s, memcell_t *mc)
+bool memcell_mark_shared(memory_state_t *s, memcell_t *mc)
 {
-	if(mc->fin) {
-		mc->fin(mc->data);
+#if defined(GC_CONCURRENT_MARK)
+	return memcell_mark(s, mc);
+#else /* ! defined(GC_CONCURRENT_MARK) */
+	uint32_t old;
+
+	if(s->mark_epoch) {
+		old = __atomic_fetch_or(&(mc->meta), MC_MARK_BIT, __ATOMIC_RELAXED);
+	} else {
+		old = __atomic_fetch_and(&(mc->meta), ~(uint32_t) MC_MARK_BIT,
+		                         __ATOMIC_RELAXED);
 	}
+	return ((old & MC_MARK_BIT) >> MC_MARK_SHIFT) != s->mark_epoch;
+#endif /* defined(GC_CONCURRENT_MARK) */
 }
+#endif /* defined(GC_PARALLEL_CYCLE) */
 
-#if ! defined(NO_GC_FREELIST)
+/* a heap cell not reached yet this cycle */
 static
-void memcell_free(memory_state_t *s, memcell_t *mc)
+bool memcell_is_unproc(memory_state_t *s, memcell_t *mc)
 {
-	memcell_deinit(s, mc);
-	mc->mc_flags.live = false;
-	dlnode_remove(&(mc->hdr));
-	dlist_insertlast(&(s->free_list), &(mc->hdr));
-#if ! defined(NO_GC_STATISTICS)
-	s->total_free++;
-#endif
+	return memcell_list(mc) == MC_LIST_HEAP && ! memcell_marked(s, mc);
 }
-#else /* defined(NO_GC_FREELIST) */
+
+/* an unreachable cell the running sweep has found or will find: only the
+   sweep may free it, nothing may drop its refcount to free it early */
 static
-void memcell_free(memory_state_t *s, memcell_t *mc)
+bool memcell_is_doomed(memory_state_t *s, memcell_t *mc)
 {
-	memcell_deinit(s, mc);
-	/* note that this is more 'hopeful' than useful, as we don't know what will
-	   happen to the memory once we call mem_free(). However, if the memory
-	   isn't immediately reused and we try to reference it, then this may help
-	   track down errors */
-	mc->mc_flags.live = false;
-	dlnode_remove(&(mc->hdr));
-	s->mem_free(mc, s->mem_alloc_priv);
-	s->total_alloc--;
+	return memcell_list(mc) == MC_LIST_DOOMED
+	       || (s->ms_flags.sweeping && memcell_is_unproc(s, mc));
 }
-#endif /* ! defined(NO_GC_FREELIST) */
 
 static
-void memcell_to_reachable(memory_state_t *s, memcell_t *mc)
+void memstate_worklist_push(memory_state_t *s, memcell_t *mc)
 {
-	dlist_insertlast(s->reachable_listref, &(mc->hdr));
-}
+	memchunk_t *chunk = s->worklist;
 
-void memory_state_init(
-	memory_state_t *s,
-	init_callback i_cb,
-	data_link_callback dl_cb,
-	print_callback p_cb,
-	mem_allocator_fn_t mem_alloc,
-	mem_free_fn_t mem_free,
-	void *mem_alloc_priv)
-{
-#if ! defined(NO_GC_FREELIST)
-	dlist_init(&(s->free_list));
-#endif /* ! defined(NO_GC_FREELIST) */
-	dlist_init(&(s->free_pending_list));
-	dlist_init(&(s->roots_list));
-	dlist_init(&(s->boundary_list));
-	dlist_init(&(s->white_list));
-	dlist_init(&(s->black_list));
-	dlnode_init(&(s->root_sentinel));
-	dlist_insertlast(&(s->roots_list), &(s->root_sentinel));
-	s->reachable_listref = &(s->white_list);
-	s->unproc_listref = &(s->black_list);
-	s->i_cb = i_cb;
-	s->dl_cb = dl_cb;
-	s->p_cb = p_cb;
-	s->total_alloc = 0;
-#if ! defined(NO_GC_FREELIST)
-	s->total_free = 0;
-#endif /* ! defined(NO_GC_FREELIST) */
-	s->iter_count = 0;
-	s->cycle_count = 0;
-	s->clean_cycles = 0;
-	s->skipped_clean_iters = 0;
-	s->ms_flags.active = false;
-	s->mem_alloc = mem_alloc;
-	s->mem_free = mem_free;
-	s->mem_alloc_priv = mem_alloc_priv;
+	if(! chunk || chunk->len == MEMORY_WORKLIST_CHUNK) {
+		if(s->worklist_spare) {
+			chunk = s->worklist_spare;
+			s->worklist_spare = NULL;
+		} else {
+			chunk = s->mem_alloc(sizeof(*chunk), s->mem_alloc_priv);
+			assert(chunk);
+		}
+		chunk->next = s->worklist;
+		chunk->len = 0;
+		s->worklist = chunk;
+	}
+	chunk->cells[chunk->len++] = mc;
+	memcell_meta_set(mc, MC_QUEUED_BIT);
+	s->worklist_len++;
 }
 
-void memory_state_reset(
-	memory_state_t *s)
+/* NULL when empty. One empty chunk is kept back, so a worklist going up and
+   down across a chunk boundary does not keep allocating. */
+static
+memcell_t *memstate_worklist_pop(memory_state_t *s)
 {
-	dlnode_t *cursor;
+	memchunk_t *chunk = s->worklist;
 	memcell_t *mc;
 
-	while(! dlist_is_empty(&(s->free_pending_list))) {
-		mc = (memcell_t *) dlist_first(&(s->free_pending_list));
-		memcell_free(s, mc);
+	if(! chunk) {
+		return NULL;
 	}
-
-	while(! dlist_is_empty(&(s->roots_list))) {
-		cursor = dlist_first(&(s->roots_list));
-		if(cursor == &(s->root_sentinel)) {
-			dlnode_remove(cursor);
+	mc = chunk->cells[--(chunk->len)];
+	memcell_meta_clear(mc, MC_QUEUED_BIT);
+	s->worklist_len--;
+	if(! chunk->len) {
+		s->worklist = chunk->next;
+		if(s->worklist_spare) {
+			s->mem_free(chunk, s->mem_alloc_priv);
 		} else {
-			mc = (memcell_t *) cursor;
-			memcell_free(s, mc);
+			s->worklist_spare = chunk;
 		}
 	}
+	return mc;
+}
 
-	while(! dlist_is_empty(&(s->boundary_list))) {
-		mc = (memcell_t *) dlist_first(&(s->boundary_list));
-		memcell_free(s, mc);
+static
+void memstate_worklist_clear(memory_state_t *s)
+{
+	while(memstate_worklist_pop(s));
+	if(s->worklist_spare) {
+		s->mem_free(s->worklist_spare, s->mem_alloc_priv);
+		s->worklist_spare = NULL;
 	}
+}
 
-	while(! dlist_is_empty(&(s->black_list))) {
-		mc = (memcell_t *) dlist_first(&(s->black_list));
-		memcell_free(s, mc);
-	}
+static void dl_cb_remember_young(void *link, void *p)
+{
+	memcell_t *mc;
 
-	while(! dlist_is_empty(&(s->white_list))) {
-		mc = (memcell_t *) dlist_first(&(s->white_list));
-		memcell_free(s, mc);
+	(void) p;
+	if(link) {
+		mc = data_to_memcell(link);
+		if(memcell_is_young(mc)) {
+			memcell_flags_set(mc, MC_FLAG_REMEMBERED);
+		}
 	}
+}
 
-#if ! defined(NO_GC_FREELIST)
-	while(! dlist_is_empty(&(s->free_list))) {
-		mc = (memcell_t *) dlnode_remove(dlist_first(&(s->free_list)));
-		s->mem_free(mc, s->mem_alloc_priv);
+/* take a cell off its GC list. A young cell leaving the nursery is no
+   longer young, so the young cells it links to must now be remembered. */
+static
+void memcell_remove(memory_state_t *s, memcell_t *mc)
+{
+	bool young = memcell_is_young(mc);
+
+	mclink_remove(&(mc->hdr));
+	memcell_set_list(mc, MC_LIST_NONE);
+	if(young) {
+		memcell_flags_clear(mc, MC_FLAG_REMEMBERED);
+		s->nursery_count--;
+		MEMSTATE_LINKS(s, dl_cb_remember_young, &(mc->data), NULL);
 	}
-#endif
 }
 
-memory_state_t *data_to_memstate(void *data)
+static
+void memcell_to_nursery(memory_state_t *s, memcell_t *mc)
 {
-	memcell_t *mc = data_to_memcell(data);
-	return mc->state;
+	mclist_insertlast(&(s->nursery_list), &(mc->hdr));
+	memcell_set_list(mc, MC_LIST_NURSERY);
+	s->nursery_count++;
 }
 
 static
-void memstate_setactive(memory_state_t *s)
+void memcell_to_roots_unproc(memory_state_t *s, memcell_t *mc)
 {
-	s->ms_flags.active = true;
+	assert(&(mc->hdr) != &(s->root_sentinel));
+	mclink_insert(s->root_sentinel.prev, &(mc->hdr), &(s->root_sentinel));
+	memcell_set_list(mc, MC_LIST_ROOT);
 }
 
 static
-void memstate_resetactive(memory_state_t *s)
+void memcell_to_roots_proc(memory_state_t *s, memcell_t *mc)
 {
-	s->ms_flags.active = false;
+	assert(&(mc->hdr) != &(s->root_sentinel));
+	mclink_insert(&(s->root_sentinel), &(mc->hdr), s->root_sentinel.next);
+	memcell_set_list(mc, MC_LIST_ROOT);
 }
 
-static bool memstate_isactive(memory_state_t *s)
+/* into the heap (unless already there), marked, with its links still to be
+   traced */
+static
+void memcell_to_boundary(memory_state_t *s, memcell_t *mc)
 {
-	return s->ms_flags.active;
+	if(memcell_list(mc) != MC_LIST_HEAP) {
+		assert(memcell_list(mc) == MC_LIST_NONE);
+#if defined(NO_GC_FREELIST)
+		mclist_insertlast(&(s->heap_list), &(mc->hdr));
+#endif /* defined(NO_GC_FREELIST) */
+		memcell_set_list(mc, MC_LIST_HEAP);
+	}
+	memcell_mark(s, mc);
+	if(! (MC_GET(mc->meta) & MC_QUEUED_BIT)) {
+		memstate_worklist_push(s, mc);
+	}
 }
 
-static void memcell_init(memory_state_t *s, memcell_t *mc)
+static
+void memcell_to_free_pending(memory_state_t *s, memcell_t *mc)
 {
-	mc->mc_flags.live = true;
-	mc->state = s;
-	memcell_unlock(mc);
-	memcell_resetref(mc);
-	memory_set_finalizer(mc->data, NULL);
-	s->i_cb(mc->data);
-	memcell_to_roots_unproc(s, mc);
+	mclist_insertlast(&(s->free_pending_list), &(mc->hdr));
+	memcell_set_list(mc, MC_LIST_FREE_PENDING);
 }
 
-#if ! defined(NO_GC_FREELIST)
-void *memory_request(memory_state_t *s, size_t len)
+static
+void memcell_deinit(memory_state_t *s, memcell_t *mc)
 {
-	memcell_t *mc;
-	DBGSTMT(char buf[21]);
-	DBGSTMT(char buf2[21]);
-	DBGSTMT(char buf3[21]);
-	DBGSTMT(char buf4[21]);
-
-	if(! dlist_is_empty(&(s->free_list))) {
-		mc = (memcell_t *) dlnode_remove(dlist_first(&(s->free_list)));
-		assert(! memcell_locked(mc));
-		//assert(! memcell_refcount(mc)); // why not enable?
-#if ! defined(NO_GC_STATISTICS)
-		assert(s->total_free);
-		s->total_free--;
-#endif /* ! defined(NO_GC_STATISTICS) */
-		DBGTRACELN(TC_MEM_ALLOC,
-		           "gc (", fmt_u64d(buf, s->iter_count), "): ",
-		           "reuse node ", fmt_ptr(buf2, mc), " ",
-		           "(", fmt_ptr(buf3, mc->data), ") ",
-		           "nfree=", fmt_u64d(buf4, s->total_free));
-	} else {
-		void *mem = s->mem_alloc(sizeof(memcell_t) + len,
-		                         s->mem_alloc_priv);
-		mc = (memcell_t *) dlnode_init(mem);
-#if ! defined(NO_GC_STATISTICS)
-		s->total_alloc++;
-#endif /* ! defined(NO_GC_STATISTICS) */
-		DBGTRACELN(TC_MEM_ALLOC,
-		           "gc (", fmt_u64d(buf, s->iter_count), "): ",
-		           "malloc node ", fmt_ptr(buf2, mc), " ",
-		           "(", fmt_ptr(buf3, mc->data), ") ",
-		           "nalloc=", fmt_u64d(buf4, s->total_alloc));
+	unsigned int fin = memcell_fin_index(mc);
+	if(fin) {
+		memcell_set_fin_index(mc, 0);
+		s->fin_table[fin](mc->data);
 	}
-
-	memcell_init(s, mc);
-	return mc->data;
 }
-#else /* defined(NO_GC_FREELIST) */
-void *memory_request(memory_state_t *s, size_t len)
+
+/* while finalizers are deferred, a cell being freed that has one is queued
+   instead, its data intact for the finalizer. Returns true if queued. */
+static
+bool memcell_defer_fin(memory_state_t *s, memcell_t *mc)
 {
-	memcell_t *mc;
-	mc = s->mem_alloc(sizeof(memcell_t) + len, s->mem_alloc_priv);
-	dlnode_init(&(mc->hdr));
-	memcell_init(s, mc);
-	s->total_alloc++;
-	return mc->data;
+	if(! s->ms_flags.defer_fin
+	   || ! memcell_fin_index(mc)
+	   || memcell_list(mc) == MC_LIST_FINALIZE) {
+		return false;
+	}
+	mclink_remove(&(mc->hdr));
+	mclist_insertlast(&(s->finalize_list), &(mc->hdr));
+	memcell_set_list(mc, MC_LIST_FINALIZE);
+	s->finalize_len++;
+	return true;
 }
-#endif /* ! defined(NO_GC_FREELIST) */
 
-void memory_set_finalizer(void *data, data_fin_t fin)
+static uintptr_t memstate_weak_hash(memory_state_t *s, memcell_t *target)
 {
-	memcell_t *mc = data_to_memcell(data);
-	
-	mc->fin = fin;
+	return (uint32_t) ((uintptr_t) target * 2654435761u) & (s->weak_len - 1);
 }
 
-bool memory_gc_is_locked(void *data)
+static void memstate_weak_insert(
+	memory_state_t *s,
+	memcell_t *holder,
+	memcell_t *target)
 {
-	if(data) {
-		return memcell_locked(data_to_memcell(data));
-	} else {
-		return false;
+	uintptr_t i = memstate_weak_hash(s, target);
+
+	while(s->weak_table[i].target) {
+		i = (i + 1) & (s->weak_len - 1);
 	}
+	s->weak_table[i].target = target;
+	s->weak_table[i].holder = holder;
+	s->weak_count++;
 }
 
-void memory_gc_lock(memory_state_t *s, void *data)
+/* move the entries to a table of len entries, passing their cells through
+   fix (if not NULL) on the way */
+static void memstate_weak_rehash(
+	memory_state_t *s,
+	uintptr_t len,
+	void *(*fix)(void *link, void *p))
 {
-	/* set locked state and make root */
+	memweak_entry_t *old = s->weak_table, *e;
+	uintptr_t old_len = s->weak_len, i;
+	void *target, *holder;
 
-	DBGSTMT(char buf[21];)
+	s->weak_table = s->mem_alloc(len * sizeof(*old), s->mem_alloc_priv);
+	assert(s->weak_table);
+	memset(s->weak_table, 0, len * sizeof(*old));
+	s->weak_len = len;
+	s->weak_count = 0;
+	for(i = 0; i < old_len; i++) {
+		e = &(old[i]);
+		if(! e->target) {
+			continue;
+		}
+		target = &(e->target->data);
+		holder = &(e->holder->data);
+		if(fix) {
+			target = fix(target, s);
+			holder = fix(holder, s);
+		}
+		memstate_weak_insert(s, data_to_memcell(holder),
+		                     data_to_memcell(target));
+	}
+	if(old) {
+		s->mem_free(old, s->mem_alloc_priv);
+	}
+}
+
+/* the entry for the weak link from holder to target (holder NULL matches
+   any), or NULL */
+static memweak_entry_t *memstate_weak_find(
+	memory_state_t *s,
+	memcell_t *holder,
+	memcell_t *target)
+{
+	uintptr_t i;
+
+	if(! s->weak_count) {
+		return NULL;
+	}
+	for(i = memstate_weak_hash(s, target);
+	    s->weak_table[i].target;
+	    i = (i + 1) & (s->weak_len - 1)) {
+		if(s->weak_table[i].target == target
+		   && (! holder || s->weak_table[i].holder == holder)) {
+			return &(s->weak_table[i]);
+		}
+	}
+	return NULL;
+}
+
+/* delete an entry, shifting back the ones after it that would no longer be
+   found past the hole */
+static void memstate_weak_delete(memory_state_t *s, memweak_entry_t *e)
+{
+	uintptr_t mask = s->weak_len - 1, i = e - s->weak_table, j, h;
+
+	for(j = (i + 1) & mask; s->weak_table[j].target; j = (j + 1) & mask) {
+		h = memstate_weak_hash(s, s->weak_table[j].target);
+		/* the entry at j stays unless the hole at i lies on its probe
+		   sequence, from h to j */
+		if(((j - h) & mask) >= ((j - i) & mask)) {
+			s->weak_table[i] = s->weak_table[j];
+			i = j;
+		}
+	}
+	s->weak_table[i].target = NULL;
+	s->weak_table[i].holder = NULL;
+	s->weak_count--;
+}
+
+static void *weak_fix_clear(void *link, void *p)
+{
+	return link == p ? NULL : link;
+}
+
+struct weak_holder
+{
+	memory_state_t *s;
+	memcell_t *holder;
+};
+
+/* every link field of a holder being freed: drop its entry, if weak */
+static void *weak_fix_unlink(void *link, void *p)
+{
+	struct weak_holder *wh = (struct weak_holder *) p;
+	memweak_entry_t *e;
+
+	if(link) {
+		e = memstate_weak_find(wh->s, wh->holder, data_to_memcell(link));
+		if(e) {
+			memstate_weak_delete(wh->s, e);
+		}
+	}
+	return link;
+}
+
+/* a cell being freed: clear the weak links to it and drop the weak links it
+   holds */
+static void memcell_weak_free(memory_state_t *s, memcell_t *mc)
+{
+	struct weak_holder wh = { s, mc };
+	memweak_entry_t *e;
+	memcell_t *holder;
+
+	if(MC_GET(mc->meta) & MC_WEAK_TARGET_BIT) {
+		while((e = memstate_weak_find(s, NULL, mc))) {
+			holder = e->holder;
+			memstate_weak_delete(s, e);
+			s->r_cb(weak_fix_clear, &(holder->data), &(mc->data));
+			s->weak_cleared++;
+		}
+		memcell_meta_clear(mc, MC_WEAK_TARGET_BIT);
+	}
+	if(MC_GET(mc->meta) & MC_WEAK_HOLDER_BIT) {
+		s->r_cb(weak_fix_unlink, &(mc->data), &wh);
+		memcell_meta_clear(mc, MC_WEAK_HOLDER_BIT);
+	}
+}
+
+#if defined(GC_CYCLE_COLLECT)
+/* a forgotten candidate's entry, so probe sequences stay intact */
+#define CYCLE_LOG_FORGOTTEN ((memcell_t *) 1)
+
+static uintptr_t memstate_cycle_hash(memcell_t *mc)
+{
+	return (uint32_t) ((uintptr_t) mc * 2654435761u)
+	       >> (32 - MEMORY_CYCLE_LOG_BITS);
+}
+
+/* mc lost a link but is still linked to: log it as a candidate cycle root.
+   A young cell is logged too, as the cells of a short-lived cycle mostly
+   are when it is dropped. A log that is too full drops it, the trace still finds the cycle. */
+static void memcell_cycle_suspect(memory_state_t *s, memcell_t *mc)
+{
+	uintptr_t i;
+
+	if((MC_GET(mc->meta) & MC_CYCLE_CAND_BIT)
+	   || (memcell_list(mc) != MC_LIST_HEAP && ! memcell_is_young(mc))
+	   || memcell_locked(mc)
+	   || s->cycle_log_count >= MEMORY_CYCLE_LOG_LEN / 8 * 7) {
+		return;
+	}
+	for(i = memstate_cycle_hash(mc);
+	    s->cycle_log[i];
+	    i = (i + 1) & (MEMORY_CYCLE_LOG_LEN - 1));
+	s->cycle_log[i] = mc;
+	s->cycle_log_count++;
+	memcell_meta_set(mc, MC_CYCLE_CAND_BIT);
+}
+
+/* a candidate being freed */
+static void memcell_cycle_forget(memory_state_t *s, memcell_t *mc)
+{
+	uintptr_t i;
+
+	if(! (MC_GET(mc->meta) & MC_CYCLE_CAND_BIT)) {
+		return;
+	}
+	for(i = memstate_cycle_hash(mc);
+	    s->cycle_log[i] != mc;
+	    i = (i + 1) & (MEMORY_CYCLE_LOG_LEN - 1)) {
+		assert(s->cycle_log[i]);
+	}
+	s->cycle_log[i] = CYCLE_LOG_FORGOTTEN;
+	memcell_meta_clear(mc, MC_CYCLE_CAND_BIT);
+}
+#else /* ! defined(GC_CYCLE_COLLECT) */
+static inline void memcell_cycle_suspect(memory_state_t *s, memcell_t *mc)
+	{ (void) s; (void) mc; }
+static inline void memcell_cycle_forget(memory_state_t *s, memcell_t *mc)
+	{ (void) s; (void) mc; }
+#endif /* defined(GC_CYCLE_COLLECT) */
+
+#if ! defined(NO_GC_FREELIST)
+static memcell_t *memslab_cell(memslab_t *slab, uintptr_t i)
+{
+	return (memcell_t *) ((char *) slab->cells + i * slab->cell_len);
+}
+
+/* the size class a slab's cells are handed out from */
+static
+memclass_t *memslab_class(memory_state_t *s, memslab_t *slab)
+{
+	if(slab->region) {
+		return &(s->region_classes[slab->cls]);
+	}
+	return &(s->classes[slab->cls]);
+}
+
+static
+void memcell_free(memory_state_t *s, memcell_t *mc)
+{
+	memslab_t *slab;
+
+	memcell_weak_free(s, mc);
+	memcell_cycle_forget(s, mc);
+	if(memcell_defer_fin(s, mc)) {
+		return;
+	}
+	memcell_deinit(s, mc);
+	memcell_flags_clear(mc, MC_FLAG_LIVE);
+	mclink_remove(&(mc->hdr));
+	slab = memcell_slab(mc);
+	mclist_insertlast(&(memslab_class(s, slab)->free_list), &(mc->hdr));
+	memcell_set_list(mc, MC_LIST_FREE);
+	if(++(slab->nfree) == slab->ncells) {
+		s->slab_empty++;
+	}
+#if ! defined(NO_GC_STATISTICS)
+	s->total_free++;
+#endif
+}
+#else /* defined(NO_GC_FREELIST) */
+static
+void memcell_free(memory_state_t *s, memcell_t *mc)
+{
+	memcell_weak_free(s, mc);
+	memcell_cycle_forget(s, mc);
+	if(memcell_defer_fin(s, mc)) {
+		return;
+	}
+	memcell_deinit(s, mc);
+	/* note that this is more 'hopeful' than useful, as we don't know what will
+	   happen to the memory once we call mem_free(). However, if the memory
+	   isn't immediately reused and we try to reference it, then this may help
+	   track down errors */
+	memcell_flags_clear(mc, MC_FLAG_LIVE);
+	memcell_remove(s, mc);
+	s->heap_len -= sizeof(memslab_t) + memcell_slab(mc)->cell_len;
+	s->mem_free(memcell_slab(mc), s->mem_alloc_priv);
+	s->total_alloc--;
+}
+#endif /* ! defined(NO_GC_FREELIST) */
+
+#if defined(GC_CONCURRENT_MARK)
+/* the marker thread traces the cells of one handed off chunk at a time,
+   using it as its stack */
+struct marker
+{
+	memory_state_t *s;
+	memchunk_t *stack;
+	memchunk_t *roots; /* linked unlocked roots, for the mutator to move */
+};
+
+static bool memstate_marker_busy(memory_state_t *s)
+{
+	return __atomic_load_n(&(s->mark_outstanding), __ATOMIC_ACQUIRE) != 0;
+}
+
+/* bring the marker's pool of spare chunks back to MEMORY_MARK_POOL, called
+   by the mutator with mark_lock held */
+static void memstate_marker_fill(memory_state_t *s)
+{
+	memchunk_t *chunk;
+
+	while(s->mark_pool_len < MEMORY_MARK_POOL) {
+		chunk = s->mem_alloc(sizeof(*chunk), s->mem_alloc_priv);
+		assert(chunk);
+		chunk->next = s->mark_pool;
+		s->mark_pool = chunk;
+		s->mark_pool_len++;
+	}
+	while(s->mark_pool_len > 2 * MEMORY_MARK_POOL) {
+		chunk = s->mark_pool;
+		s->mark_pool = chunk->next;
+		s->mark_pool_len--;
+		s->mem_free(chunk, s->mem_alloc_priv);
+	}
+	if(s->mark_need_chunks) {
+		s->mark_need_chunks = false;
+		pthread_cond_broadcast(&(s->mark_cond));
+	}
+}
+
+/* the marker waits for spare chunks from the mutator's next GC step */
+static void memstate_marker_refill(memory_state_t *s)
+{
+	if(__atomic_load_n(&(s->mark_need_chunks), __ATOMIC_RELAXED)) {
+		pthread_mutex_lock(&(s->mark_lock));
+		memstate_marker_fill(s);
+		pthread_mutex_unlock(&(s->mark_lock));
+	}
+}
+
+/* wait until the marker has traced everything handed to it */
+static void memstate_marker_sync(memory_state_t *s)
+{
+	pthread_mutex_lock(&(s->mark_lock));
+	while(s->mark_outstanding) {
+		memstate_marker_fill(s);
+		pthread_cond_wait(&(s->mark_cond), &(s->mark_lock));
+	}
+	pthread_mutex_unlock(&(s->mark_lock));
+}
+
+/* take a spare chunk, waiting for the mutator if there is none */
+static memchunk_t *marker_chunk(memory_state_t *s, memchunk_t *next)
+{
+	memchunk_t *chunk;
+
+	pthread_mutex_lock(&(s->mark_lock));
+	while(! s->mark_pool) {
+		__atomic_store_n(&(s->mark_need_chunks), true, __ATOMIC_RELAXED);
+		pthread_cond_broadcast(&(s->mark_cond));
+		pthread_cond_wait(&(s->mark_cond), &(s->mark_lock));
+	}
+	chunk = s->mark_pool;
+	s->mark_pool = chunk->next;
+	s->mark_pool_len--;
+	pthread_mutex_unlock(&(s->mark_lock));
+	chunk->next = next;
+	chunk->len = 0;
+	return chunk;
+}
+
+static void marker_push(struct marker *m, memcell_t *mc)
+{
+	if(m->stack->len == MEMORY_WORKLIST_CHUNK) {
+		m->stack = marker_chunk(m->s, m->stack);
+	}
+	m->stack->cells[m->stack->len++] = mc;
+}
+
+/* only the mutator may move a cell out of the roots list */
+static void marker_return_root(struct marker *m, memcell_t *mc)
+{
+	if(! m->roots || m->roots->len == MEMORY_WORKLIST_CHUNK) {
+		m->roots = marker_chunk(m->s, m->roots);
+	}
+	m->roots->cells[m->roots->len++] = mc;
+}
+
+/* NULL once the stack is empty, its last chunk is kept */
+static memcell_t *marker_pop(struct marker *m)
+{
+	memory_state_t *s = m->s;
+	memchunk_t *chunk;
+
+	while(! m->stack->len) {
+		if(! m->stack->next) {
+			return NULL;
+		}
+		chunk = m->stack;
+		m->stack = chunk->next;
+		pthread_mutex_lock(&(s->mark_lock));
+		chunk->next = s->mark_pool;
+		s->mark_pool = chunk;
+		s->mark_pool_len++;
+		pthread_mutex_unlock(&(s->mark_lock));
+	}
+	return m->stack->cells[--(m->stack->len)];
+}
+
+/* the mutator may be moving the cell between lists meanwhile. A cell seen
+   in the heap is live: the mutator frees no marked cell while the marker
+   is busy, and marks (claims) any other before freeing it. */
+static void dl_cb_marker_trace(void *link, void *p)
+{
+	struct marker *m = (struct marker *) p;
+	memcell_t *mc;
+
+	if(! link) {
+		return;
+	}
+	mc = data_to_memcell(link);
+	/* the acquire pairs with MC_SET(), so the cell's links are seen as
+	   they were when it joined the heap, or later */
+	switch(__atomic_load_n(&(mc->meta), __ATOMIC_ACQUIRE) & MC_LIST_MASK) {
+	case MC_LIST_HEAP:
+		if(memcell_mark(m->s, mc)) {
+			marker_push(m, mc);
+		}
+		break;
+	case MC_LIST_ROOT:
+		if(! (__atomic_load_n(&(mc->rc_flags), __ATOMIC_RELAXED)
+		      & MC_FLAG_LOCKED)) {
+			marker_return_root(m, mc);
+		}
+		break;
+	default:
+		break;
+	}
+}
+
+static void *memstate_marker_main(void *p)
+{
+	memory_state_t *s = (memory_state_t *) p;
+	struct marker m = { s, NULL, NULL };
+	unsigned long long traced;
+	memchunk_t *chunk;
+	memcell_t *mc;
+
+	pthread_mutex_lock(&(s->mark_lock));
+	for(;;) {
+		while(! s->mark_queue && ! s->mark_stop) {
+			pthread_cond_wait(&(s->mark_cond), &(s->mark_lock));
+		}
+		if(! s->mark_queue) {
+			break;
+		}
+		m.stack = s->mark_queue;
+		s->mark_queue = m.stack->next;
+		m.stack->next = NULL;
+		pthread_mutex_unlock(&(s->mark_lock));
+
+		traced = 0;
+		while((mc = marker_pop(&m))) {
+			MEMSTATE_LINKS(s, dl_cb_marker_trace, &(mc->data), &m);
+			traced++;
+		}
+
+		pthread_mutex_lock(&(s->mark_lock));
+		m.stack->next = s->mark_pool;
+		s->mark_pool = m.stack;
+		s->mark_pool_len++;
+		while((chunk = m.roots)) {
+			m.roots = chunk->next;
+			chunk->next = s->mark_returned;
+			/* the mutator checks for returned roots without the lock */
+			__atomic_store_n(&(s->mark_returned), chunk, __ATOMIC_RELEASE);
+		}
+		s->mark_traced += traced;
+		/* the release publishes the marks to the mutator */
+		if(! __atomic_sub_fetch(&(s->mark_outstanding), 1, __ATOMIC_RELEASE)) {
+			pthread_cond_broadcast(&(s->mark_cond));
+		}
+	}
+	pthread_mutex_unlock(&(s->mark_lock));
+	return NULL;
+}
+
+/* move the linked unlocked roots the marker found into the heap, as a GC
+   step tracing a link to one would. They may have changed since. */
+static void memstate_marker_collect(memory_state_t *s)
+{
+	memchunk_t *chunk, *next;
+	memcell_t *mc;
+	uintptr_t i;
+
+	if(! __atomic_load_n(&(s->mark_returned), __ATOMIC_ACQUIRE)) {
+		return;
+	}
+	pthread_mutex_lock(&(s->mark_lock));
+	chunk = s->mark_returned;
+	__atomic_store_n(&(s->mark_returned), NULL, __ATOMIC_RELAXED);
+	pthread_mutex_unlock(&(s->mark_lock));
+	for(; chunk; chunk = next) {
+		next = chunk->next;
+		for(i = 0; i < chunk->len; i++) {
+			mc = chunk->cells[i];
+			if(memcell_list(mc) == MC_LIST_ROOT
+			   && ! memcell_locked(mc)
+			   && memcell_refcount(mc)) {
+				memcell_remove(s, mc);
+				memcell_to_boundary(s, mc);
+			}
+		}
+		s->mem_free(chunk, s->mem_alloc_priv);
+	}
+}
+
+/* hand the top chunk of the worklist over to the marker thread. Cells
+   that left the heap since they were queued are dropped from it. */
+static void memstate_marker_handoff(memory_state_t *s)
+{
+	memchunk_t *chunk = s->worklist;
+	memcell_t *mc;
+	uintptr_t i, len = 0;
+
+	s->worklist = chunk->next;
+	s->worklist_len -= chunk->len;
+	for(i = 0; i < chunk->len; i++) {
+		mc = chunk->cells[i];
+		memcell_meta_clear(mc, MC_QUEUED_BIT);
+		if(memcell_list(mc) == MC_LIST_HEAP) {
+			chunk->cells[len++] = mc;
+		}
+	}
+	chunk->len = len;
+	if(! len) {
+		s->mem_free(chunk, s->mem_alloc_priv);
+		return;
+	}
+
+	pthread_mutex_lock(&(s->mark_lock));
+	chunk->next = s->mark_queue;
+	s->mark_queue = chunk;
+	__atomic_add_fetch(&(s->mark_outstanding), 1, __ATOMIC_RELAXED);
+	memstate_marker_fill(s);
+	pthread_cond_broadcast(&(s->mark_cond));
+	pthread_mutex_unlock(&(s->mark_lock));
+}
+
+/* marks are kept in slab bitmaps here, so unmarking means clearing them */
+static void memstate_clear_marks(memory_state_t *s)
+{
+	dlnode_t *cursor;
+
+	DLIST_FOR_FWD(&(s->slab_list), cursor) {
+		memset(((memslab_t *) cursor)->marks, 0,
+		       sizeof(((memslab_t *) cursor)->marks));
+	}
+}
+#endif /* defined(GC_CONCURRENT_MARK) */
+
+bool memory_gc_start_marker(memory_state_t *s)
+{
+#if defined(GC_CONCURRENT_MARK)
+	if(s->mark_running) {
+		return true;
+	}
+	s->mark_stop = false;
+	if(pthread_create(&(s->mark_thread), NULL, memstate_marker_main, s)) {
+		return false;
+	}
+	s->mark_running = true;
+	return true;
+#else
+	(void) s;
+	return false;
+#endif /* defined(GC_CONCURRENT_MARK) */
+}
+
+void memory_gc_stop_marker(memory_state_t *s)
+{
+#if defined(GC_CONCURRENT_MARK)
+	memchunk_t *chunk;
+
+	if(! s->mark_running) {
+		return;
+	}
+	memstate_marker_sync(s);
+	pthread_mutex_lock(&(s->mark_lock));
+	s->mark_stop = true;
+	pthread_cond_broadcast(&(s->mark_cond));
+	pthread_mutex_unlock(&(s->mark_lock));
+	pthread_join(s->mark_thread, NULL);
+	s->mark_running = false;
+	memstate_marker_collect(s);
+	while((chunk = s->mark_pool)) {
+		s->mark_pool = chunk->next;
+		s->mem_free(chunk, s->mem_alloc_priv);
+	}
+	s->mark_pool_len = 0;
+#else
+	(void) s;
+#endif /* defined(GC_CONCURRENT_MARK) */
+}
+
+void memory_state_init(
+	memory_state_t *s,
+	init_callback i_cb,
+	data_link_callback dl_cb,
+	data_relocate_callback r_cb,
+	print_callback p_cb,
+	mem_allocator_fn_t mem_alloc,
+	mem_free_fn_t mem_free,
+	void *mem_alloc_priv)
+{
+#if ! defined(NO_GC_FREELIST)
+	unsigned int i;
+#endif /* ! defined(NO_GC_FREELIST) */
+
+#if ! defined(NO_GC_FREELIST)
+	for(i = 0; i < MEMORY_SIZE_CLASSES; i++) {
+		mclist_init(&(s->classes[i].free_list));
+		s->classes[i].slab_cur = NULL;
+		mclist_init(&(s->region_classes[i].free_list));
+		s->region_classes[i].slab_cur = NULL;
+	}
+	dlist_init(&(s->slab_list));
+	s->slab_count = 0;
+	s->slab_table = NULL;
+	s->slab_table_len = 0;
+	s->slab_id_hint = 1;
+	s->slab_reserve = NULL;
+	s->slab_empty = 0;
+	s->trim_high = MEMORY_TRIM_HIGH;
+	s->trim_low = MEMORY_TRIM_LOW;
+	s->released_slabs = 0;
+	s->released_cells = 0;
+	s->region_freed = 0;
+	s->compacted_cells = 0;
+#endif /* ! defined(NO_GC_FREELIST) */
+	mclist_init(&(s->free_pending_list));
+	mclist_init(&(s->roots_list));
+	s->worklist = NULL;
+	s->worklist_spare = NULL;
+	s->worklist_len = 0;
+#if defined(NO_GC_FREELIST)
+	mclist_init(&(s->heap_list));
+	mclist_init(&(s->sweep_sentinel));
+#else
+	s->sweep_slab = NULL;
+	s->sweep_index = 0;
+#endif /* defined(NO_GC_FREELIST) */
+	s->mark_epoch = 0;
+	mclist_init(&(s->doomed_list));
+	mclist_init(&(s->finalize_list));
+	s->finalize_len = 0;
+	s->finalized_count = 0;
+	mclist_init(&(s->nursery_list));
+	s->nursery_count = 0;
+	s->nursery_len = MEMORY_NURSERY_LEN;
+	s->minor_count = 0;
+	s->promoted_count = 0;
+	s->young_free_count = 0;
+	s->heap_len = 0;
+	s->soft_limit = 0;
+	s->hard_limit = 0;
+	s->pressure_count = 0;
+	s->gc_pace = MEMORY_GC_PACE;
+	s->gc_debt = 0;
+	s->paced_iters = 0;
+	s->paced_cycles = 0;
+	s->adapt_requested = 0;
+	s->adapt_steps = 0;
+	s->adapt_last_requested = 0;
+	s->adapt_last_steps = 0;
+	s->adapt_budget = 0;
+	s->adapt_free_ratio = 0;
+	s->adapt_count = 0;
+#if defined(GC_DEFERRED_RC)
+	memset(s->rc_log, 0, sizeof(s->rc_log));
+	s->rc_log_count = 0;
+#endif /* defined(GC_DEFERRED_RC) */
+#if defined(GC_CONCURRENT_MARK)
+	pthread_mutex_init(&(s->mark_lock), NULL);
+	pthread_cond_init(&(s->mark_cond), NULL);
+	s->mark_queue = NULL;
+	s->mark_returned = NULL;
+	s->mark_pool = NULL;
+	s->mark_pool_len = 0;
+	s->mark_outstanding = 0;
+	s->mark_traced = 0;
+	s->mark_running = false;
+	s->mark_stop = false;
+	s->mark_need_chunks = false;
+#endif /* defined(GC_CONCURRENT_MARK) */
+	s->weak_table = NULL;
+	s->weak_len = 0;
+	s->weak_count = 0;
+	s->weak_cleared = 0;
+	s->shadow = NULL;
+	s->shadow_len = 0;
+	s->shadow_cap = 0;
+	dlist_init(&(s->large_list));
+	s->large_len = 0;
+#if defined(GC_CYCLE_COLLECT)
+	memset(s->cycle_log, 0, sizeof(s->cycle_log));
+	s->cycle_log_count = 0;
+	s->trial_table = NULL;
+	s->trial_order = NULL;
+#endif /* defined(GC_CYCLE_COLLECT) */
+	s->trial_passes = 0;
+	s->trial_freed = 0;
+	s->rc_advised = 0;
+	s->rc_applied = 0;
+	mclist_init(&(s->root_sentinel));
+	mclist_insertlast(&(s->roots_list), &(s->root_sentinel));
+	memset(s->fin_table, 0, sizeof(s->fin_table));
+	s->i_cb = i_cb;
+	s->dl_cb = dl_cb;
+	s->r_cb = r_cb;
+	s->p_cb = p_cb;
+	s->total_alloc = 0;
+#if ! defined(NO_GC_FREELIST)
+	s->total_free = 0;
+#endif /* ! defined(NO_GC_FREELIST) */
+	s->iter_count = 0;
+	s->cycle_count = 0;
+	s->clean_cycles = 0;
+	s->skipped_clean_iters = 0;
+	s->ms_flags.active = false;
+	s->ms_flags.trimming = false;
+	s->ms_flags.nursery_swept = false;
+	s->ms_flags.oom = false;
+	s->ms_flags.region = false;
+	s->ms_flags.sweeping = false;
+	s->ms_flags.defer_fin = false;
+	s->ms_flags.shadow_scanned = false;
+	s->ms_flags.adaptive = false;
+	s->ms_flags.pacing = false;
+	s->ms_flags.unpaced = false;
+	s->mem_alloc = mem_alloc;
+	s->mem_free = mem_free;
+	s->mem_alloc_priv = mem_alloc_priv;
+}
+
+void memory_state_reset(
+	memory_state_t *s)
+{
+	memcell_t *mc;
+	memlarge_t *lo;
+#if defined(NO_GC_FREELIST)
+	mclink_t *cursor;
+#else /* ! defined(NO_GC_FREELIST) */
+	dlnode_t *slab_cursor;
+	memslab_t *slab;
+	uintptr_t j;
+	unsigned int i;
+#endif /* ! defined(NO_GC_FREELIST) */
+
+	memory_gc_stop_marker(s);
+	memory_gc_rc_flush(s);
+	memstate_worklist_clear(s);
+	memory_gc_defer_finalizers(s, false);
+
+#if defined(NO_GC_FREELIST)
+	/* every cell has an allocation of its own to free */
+	while(! mclist_is_empty(&(s->doomed_list))) {
+		memcell_free(s, (memcell_t *) mclist_first(&(s->doomed_list)));
+	}
+
+	while(! mclist_is_empty(&(s->free_pending_list))) {
+		mc = (memcell_t *) mclist_first(&(s->free_pending_list));
+		memcell_free(s, mc);
+	}
+
+	while(! mclist_is_empty(&(s->nursery_list))) {
+		mc = (memcell_t *) mclist_first(&(s->nursery_list));
+		memcell_set_list(mc, MC_LIST_NONE);
+		memcell_free(s, mc);
+	}
+	s->nursery_count = 0;
+
+	while(! mclist_is_empty(&(s->roots_list))) {
+		cursor = mclist_first(&(s->roots_list));
+		if(cursor == &(s->root_sentinel)) {
+			mclink_remove(cursor);
+		} else {
+			mc = (memcell_t *) cursor;
+			memcell_free(s, mc);
+		}
+	}
+
+	mclink_remove(&(s->sweep_sentinel));
+	while(! mclist_is_empty(&(s->heap_list))) {
+		mc = (memcell_t *) mclist_first(&(s->heap_list));
+		memcell_free(s, mc);
+	}
+	/* every weak link went with its holder */
+	assert(! s->weak_count);
+#else /* ! defined(NO_GC_FREELIST) */
+	/* the cells are not freed one by one, as their slabs go whole: only run
+	   the finalizers, in the slabs that have cells with one. The cells stay
+	   intact until all have run. */
+	DLIST_FOR_FWD(&(s->slab_list), slab_cursor) {
+		slab = (memslab_t *) slab_cursor;
+		for(j = 0; slab->nfin && j < slab->ncells; j++) {
+			mc = memslab_cell(slab, j);
+			if(memcell_live(mc) && memcell_fin_index(mc)) {
+				memcell_deinit(s, mc);
+			}
+		}
+	}
+	mclist_init(&(s->doomed_list));
+	mclist_init(&(s->free_pending_list));
+	mclist_init(&(s->nursery_list));
+	s->nursery_count = 0;
+	mclist_init(&(s->roots_list));
+	mclist_init(&(s->root_sentinel));
+	/* every weak link goes with its holder */
+	s->weak_count = 0;
+
+	while(! dlist_is_empty(&(s->slab_list))) {
+		s->mem_free(dlnode_remove(dlist_first(&(s->slab_list))),
+		            s->mem_alloc_priv);
+	}
+	if(s->slab_reserve) {
+		s->mem_free(s->slab_reserve, s->mem_alloc_priv);
+		s->slab_reserve = NULL;
+	}
+	if(s->slab_table) {
+		s->mem_free(s->slab_table, s->mem_alloc_priv);
+	}
+	for(i = 0; i < MEMORY_SIZE_CLASSES; i++) {
+		mclist_init(&(s->classes[i].free_list));
+		s->classes[i].slab_cur = NULL;
+		mclist_init(&(s->region_classes[i].free_list));
+		s->region_classes[i].slab_cur = NULL;
+	}
+	s->slab_count = 0;
+	s->slab_table = NULL;
+	s->slab_table_len = 0;
+	s->slab_id_hint = 1;
+	s->slab_empty = 0;
+	s->ms_flags.trimming = false;
+	s->total_alloc = 0;
+	s->total_free = 0;
+	s->heap_len = 0;
+	s->gc_debt = 0;
+	s->sweep_slab = NULL;
+	s->sweep_index = 0;
+#endif
+	/* the cells owning large objects returned them when finalized, the
+	   rest go wholesale like the slabs */
+	while(! dlist_is_empty(&(s->large_list))) {
+		lo = (memlarge_t *) dlnode_remove(dlist_first(&(s->large_list)));
+		munmap(lo, lo->len);
+	}
+	s->large_len = 0;
+	s->heap_len = 0;
+#if defined(GC_CYCLE_COLLECT)
+	/* the candidates are all forgotten now */
+	memset(s->cycle_log, 0, sizeof(s->cycle_log));
+	s->cycle_log_count = 0;
+	if(s->trial_table) {
+		s->mem_free(s->trial_table, s->mem_alloc_priv);
+		s->mem_free(s->trial_order, s->mem_alloc_priv);
+		s->trial_table = NULL;
+		s->trial_order = NULL;
+	}
+#endif /* defined(GC_CYCLE_COLLECT) */
+	if(s->weak_table) {
+		s->mem_free(s->weak_table, s->mem_alloc_priv);
+		s->weak_table = NULL;
+	}
+	s->weak_len = 0;
+	/* every root slot was popped by its owner */
+	assert(! s->shadow_len);
+	if(s->shadow) {
+		s->mem_free(s->shadow, s->mem_alloc_priv);
+		s->shadow = NULL;
+	}
+	s->shadow_cap = 0;
+	s->mark_epoch = 0;
+	s->ms_flags.sweeping = false;
+	s->ms_flags.shadow_scanned = false;
+	s->ms_flags.oom = false;
+	s->ms_flags.region = false;
+}
+
+memory_state_t *data_to_memstate(void *data)
+{
+	memcell_t *mc = data_to_memcell(data);
+	return memcell_slab(mc)->state;
+}
+
+static
+void memstate_setactive(memory_state_t *s)
+{
+	s->ms_flags.active = true;
+}
+
+static
+void memstate_resetactive(memory_state_t *s)
+{
+	s->ms_flags.active = false;
+}
+
+static bool memstate_isactive(memory_state_t *s)
+{
+	return s->ms_flags.active;
+}
+
+static void memcell_init(memory_state_t *s, memcell_t *mc)
+{
+	MC_SET(mc->rc_flags, MC_FLAG_LIVE); /* unlocked, refcount 0 */
+	memcell_set_list(mc, MC_LIST_NONE);
+	memcell_set_fin_index(mc, 0);
+	s->i_cb(mc->data);
+	if(s->nursery_len) {
+		memcell_to_nursery(s, mc);
+	} else {
+		memcell_to_roots_unproc(s, mc);
+	}
+}
+
+/* the heap is about to grow by len bytes: past the soft limit (or the hard
+   one, if only that is set) collect everything first, so the caller may find
+   a free cell instead */
+static void memstate_pressure(memory_state_t *s, uintptr_t len)
+{
+	uintptr_t limit = s->soft_limit ? s->soft_limit : s->hard_limit;
+	DBGSTMT(char buf[21]);
+
+	/* not from a finalizer run by the GC: past the hard limit eval still
+	   unwinds */
+	if(! limit || s->heap_len + len <= limit || memstate_isactive(s)) {
+		return;
+	}
+	s->pressure_count++;
+	DBGTRACELN(TC_MEM_ALLOC,
+	           "gc: heap pressure, heap_len=", fmt_u64d(buf, s->heap_len));
+	if(s->nursery_len) {
+		memory_gc_minor(s);
+	}
+	/* 2 clean cycles allows unprocessed nodes to reach the free list */
+	memory_gc_cycle(s);
+	memory_gc_cycle(s);
+}
+
+/* a cycle ended: pick the pace for the next one (see MEMORY_ADAPT_GROWTH) */
+static void memstate_adapt(memory_state_t *s)
+{
+	uintptr_t free_len = 0, budget, pace;
+	unsigned long long target;
+	DBGSTMT(char buf[21]);
+	DBGSTMT(char buf2[21]);
+	DBGSTMT(char buf3[21]);
+
+	s->adapt_last_requested = s->adapt_requested;
+	s->adapt_last_steps = s->adapt_steps;
+	s->adapt_requested = 0;
+	s->adapt_steps = 0;
+	if(s->ms_flags.unpaced) {
+		s->ms_flags.unpaced = false;
+		return;
+	}
+	if(s->adapt_last_steps) {
+		s->paced_cycles++;
+	}
+	/* cycles run without steps tell nothing about their length, and ones
+	   run explicitly nothing about the pace */
+	if(! s->ms_flags.adaptive || ! s->adapt_last_steps) {
+		return;
+	}
+
+#if ! defined(NO_GC_FREELIST) && ! defined(NO_GC_STATISTICS)
+	if(s->total_alloc) {
+		s->adapt_free_ratio = s->total_free * 100 / s->total_alloc;
+		free_len = (s->heap_len - s->large_len) / s->total_alloc
+		           * s->total_free;
+	}
+#endif
+	budget = free_len + s->heap_len / MEMORY_ADAPT_GROWTH;
+	if(budget < MEMORY_PACE_UNIT) {
+		budget = MEMORY_PACE_UNIT;
+	}
+	target = (unsigned long long) s->adapt_last_steps * MEMORY_PACE_UNIT
+	         / budget;
+	pace = (s->gc_pace + target + 1) / 2;
+	if(pace < MEMORY_ADAPT_PACE_MIN) {
+		pace = MEMORY_ADAPT_PACE_MIN;
+	}
+	if(pace > MEMORY_ADAPT_PACE_MAX) {
+		pace = MEMORY_ADAPT_PACE_MAX;
+	}
+	s->adapt_budget = budget;
+	if(pace != s->gc_pace) {
+		DBGTRACELN(TC_GC_TRACING,
+		           "gc adapt: pace ", fmt_u64d(buf, s->gc_pace),
+		           " -> ", fmt_u64d(buf2, pace), " ",
+		           "budget=", fmt_u64d(buf3, budget));
+		s->gc_pace = pace;
+		s->adapt_count++;
+	}
+}
+
+/* the cycle in progress has requested more than its pace was picked for, so
+   the heap is growing past the free cells: speed up now instead of at the
+   end of a cycle that is getting longer with the heap. This repeats for
+   every further 1/MEMORY_ADAPT_GROWTH of the heap requested. */
+static void memstate_adapt_starved(memory_state_t *s)
+{
+	DBGSTMT(char buf[21]);
+	DBGSTMT(char buf2[21]);
+
+	s->adapt_budget += s->heap_len / MEMORY_ADAPT_GROWTH + MEMORY_PACE_UNIT;
+	if(s->gc_pace >= MEMORY_ADAPT_PACE_MAX) {
+		return;
+	}
+	DBGTRACELN(TC_GC_TRACING,
+	           "gc adapt: starved, pace ", fmt_u64d(buf, s->gc_pace),
+	           " budget=", fmt_u64d(buf2, s->adapt_budget));
+	s->gc_pace = s->gc_pace ? 2 * s->gc_pace : MEMORY_ADAPT_PACE_MIN;
+	if(s->gc_pace > MEMORY_ADAPT_PACE_MAX) {
+		s->gc_pace = MEMORY_ADAPT_PACE_MAX;
+	}
+	s->adapt_count++;
+}
+
+/* len more bytes are being requested: pay the GC debt that adds */
+static void memstate_pace(memory_state_t *s, uintptr_t len)
+{
+	uintptr_t steps, done;
+
+	s->adapt_requested += len;
+	if(s->ms_flags.adaptive && s->gc_pace && s->adapt_budget
+	   && s->adapt_requested > s->adapt_budget) {
+		memstate_adapt_starved(s);
+	}
+	s->gc_debt += len * s->gc_pace;
+	/* a finalizer run by the GC is requesting memory: GC work does not
+	   nest, so the debt is paid by a later request */
+	if(memstate_isactive(s)) {
+		return;
+	}
+#if defined(GC_CYCLE_COLLECT)
+	/* refcounting logs candidates whatever the pace, so a full log is not
+	   left waiting for a GC step, which a low pace makes rare */
+	if(s->cycle_log_count >= MEMORY_CYCLE_LOG_LEN / 4 * 3) {
+		memory_gc_collect_cycles(s);
+	}
+#endif /* defined(GC_CYCLE_COLLECT) */
+	if(s->gc_debt < MEMORY_PACE_UNIT) {
+		return;
+	}
+	steps = s->gc_debt / MEMORY_PACE_UNIT;
+	s->gc_debt %= MEMORY_PACE_UNIT;
+	s->ms_flags.pacing = true;
+	done = memory_gc_iterate_n(s, steps, 0);
+	s->ms_flags.pacing = false;
+	s->paced_iters += done;
+	if(done < steps) {
+		/* nothing left to collect, do not bank the work for later */
+		s->gc_debt = 0;
+	}
+}
+
+/* nothing is left to hand out a cell from, and callers never see NULL */
+static void memstate_alloc_fatal(uintptr_t len)
+{
+	fprintf(stderr, "gc: out of memory, allocator failed for %lu bytes\n",
+	        (unsigned long) len);
+	abort();
+}
+
+/* account for len more bytes of heap */
+static void memstate_grow(memory_state_t *s, uintptr_t len)
+{
+	DBGSTMT(char buf[21]);
+
+	s->heap_len += len;
+	if(s->hard_limit && s->heap_len > s->hard_limit && ! s->ms_flags.oom) {
+		DBGTRACELN(TC_MEM_ALLOC,
+		           "gc: out of memory, heap_len=",
+		           fmt_u64d(buf, s->heap_len));
+		s->ms_flags.oom = true;
+	}
+}
+
+#if ! defined(NO_GC_FREELIST)
+/* the allocator failed: eval unwinds with EVAL_ERR_OUT_OF_MEM, as past the
+   hard limit */
+static void memstate_alloc_failed(memory_state_t *s, uintptr_t len)
+{
+	DBGSTMT(char buf[21]);
+
+	DBGTRACELN(TC_MEM_ALLOC,
+	           "gc: out of memory, allocator failed for ",
+	           fmt_u64d(buf, len));
+	s->ms_flags.oom = true;
+}
+
+/* record slab in the slab table so memory_ref_t can be decoded, false if
+   the table can't grow or every id is taken */
+static bool memslab_register(memory_state_t *s, memslab_t *slab)
+{
+	memslab_t **table;
+	uintptr_t len, id, i;
+
+	/* slot 0 is never used: a zero memory_ref_t is NULL */
+	for(id = s->slab_id_hint; id < s->slab_table_len; id++) {
+		if(! s->slab_table[id]) {
+			break;
+		}
+	}
+	if(id >= MEMORY_REF_MAX_SLABS) {
+		return false;
+	}
+	if(id >= s->slab_table_len) {
+		len = s->slab_table_len ? s->slab_table_len * 2 : 64;
+		table = s->mem_alloc(len * sizeof(*table), s->mem_alloc_priv);
+		if(! table) {
+			return false;
+		}
+		for(i = 0; i < s->slab_table_len; i++) {
+			table[i] = s->slab_table[i];
+		}
+		for(; i < len; i++) {
+			table[i] = NULL;
+		}
+		if(s->slab_table) {
+			s->mem_free(s->slab_table, s->mem_alloc_priv);
+		}
+		s->slab_table = table;
+		s->slab_table_len = len;
+	}
+	slab->id = id;
+	s->slab_id_hint = id + 1;
+	s->slab_table[id] = slab;
+	return true;
+}
+
+/* a registered slab from the allocator, NULL if it or the slab table
+   can't be had */
+static memslab_t *memslab_alloc(memory_state_t *s)
+{
+	memslab_t *slab;
+
+	slab = s->mem_alloc(MEMORY_SLAB_LEN, s->mem_alloc_priv);
+	if(slab && ! memslab_register(s, slab)) {
+		s->mem_free(slab, s->mem_alloc_priv);
+		slab = NULL;
+	}
+	return slab;
+}
+
+static memslab_t *memslab_new(memory_state_t *s, unsigned int cls)
+{
+	size_t cell_len = sizeof(memcell_t) + (cls + 1) * MEMORY_CLASS_GRANULE;
+	memslab_t *slab;
+	DBGSTMT(char buf[21]);
+	DBGSTMT(char buf2[21]);
+
+	slab = memslab_alloc(s);
+	/* one slab is held back for when the allocator fails: it serves the
+	   requests made while eval unwinds */
+	if(slab && ! s->slab_reserve) {
+		s->slab_reserve = memslab_alloc(s);
+	}
+	if(! slab) {
+		memstate_alloc_failed(s, MEMORY_SLAB_LEN);
+		slab = s->slab_reserve;
+		s->slab_reserve = NULL;
+		if(! slab) {
+			memstate_alloc_fatal(MEMORY_SLAB_LEN);
+		}
+	}
+	dlnode_init(&(slab->hdr));
+	slab->state = s;
+	slab->cls = cls;
+	slab->region = s->ms_flags.region;
+	slab->cell_len = cell_len;
+	slab->ncells = 0;
+	slab->nfree = 0;
+	slab->nfin = 0;
+	slab->capacity = (MEMORY_SLAB_LEN - sizeof(memslab_t)) / cell_len;
+	assert(slab->capacity);
+#if defined(GC_CONCURRENT_MARK)
+	memset(slab->marks, 0, sizeof(slab->marks));
+#endif /* defined(GC_CONCURRENT_MARK) */
+	dlist_insertlast(&(s->slab_list), &(slab->hdr));
+	memstate_grow(s, MEMORY_SLAB_LEN);
+	s->slab_count++;
+	s->slab_empty++;
+	DBGTRACELN(TC_MEM_ALLOC,
+	           "gc: new slab ", fmt_ptr(buf, slab), " ",
+	           "nslabs=", fmt_u64d(buf2, s->slab_count));
+	return slab;
+}
+
+static bool memslab_exhausted(memclass_t *c)
+{
+	return ! c->slab_cur || c->slab_cur->ncells == c->slab_cur->capacity;
+}
+
+/* carve a new cell out of the class's current slab, starting a new slab if
+   it is exhausted */
+static memcell_t *memslab_carve(memory_state_t *s,
+                                memclass_t *c,
+                                unsigned int cls)
+{
+	memslab_t *slab = c->slab_cur;
+	memcell_t *mc;
+
+	if(memslab_exhausted(c)) {
+		slab = c->slab_cur = memslab_new(s, cls);
+	}
+	mc = (memcell_t *) ((char *) slab->cells
+	                    + slab->ncells * slab->cell_len);
+	memcell_set_slab(mc, slab);
+	if(slab->nfree == slab->ncells) {
+		s->slab_empty--;
+	}
+	slab->ncells++;
+	return mc;
+}
+
+/* hand an empty slab back to the allocator, pulling its cells off the free
+   list first */
+static void memslab_release(memory_state_t *s, memslab_t *slab)
+{
+	memcell_t *mc;
+	uintptr_t i;
+	DBGSTMT(char buf[21]);
+	DBGSTMT(char buf2[21]);
+
+	assert(slab->nfree == slab->ncells);
+	for(i = 0; i < slab->ncells; i++) {
+		mc = memslab_cell(slab, i);
+		assert(memcell_list(mc) == MC_LIST_FREE);
+		mclink_remove(&(mc->hdr));
+	}
+#if ! defined(NO_GC_STATISTICS)
+	assert(s->total_free >= slab->ncells);
+	s->total_free -= slab->ncells;
+	s->total_alloc -= slab->ncells;
+#endif /* ! defined(NO_GC_STATISTICS) */
+	s->released_cells += slab->ncells;
+	s->released_slabs++;
+	s->slab_empty--;
+	s->slab_count--;
+	s->heap_len -= MEMORY_SLAB_LEN;
+	s->slab_table[slab->id] = NULL;
+	if(slab->id < s->slab_id_hint) {
+		s->slab_id_hint = slab->id;
+	}
+	if(memslab_class(s, slab)->slab_cur == slab) {
+		memslab_class(s, slab)->slab_cur = NULL;
+	}
+	if(s->sweep_slab == &(slab->hdr)) {
+		s->sweep_slab = dlnode_next(&(slab->hdr));
+		s->sweep_index = 0;
+	}
+	dlnode_remove(&(slab->hdr));
+	DBGTRACELN(TC_MEM_ALLOC,
+	           "gc: release slab ", fmt_ptr(buf, slab), " ",
+	           "nslabs=", fmt_u64d(buf2, s->slab_count));
+	s->mem_free(slab, s->mem_alloc_priv);
+}
+
+/* called from the GC idle path: once more than trim_high slabs are empty,
+   release one per idle iteration until no more than trim_low are left */
+static void memslab_trim(memory_state_t *s)
+{
+	dlnode_t *cursor;
+	memslab_t *slab;
+
+	if(! s->ms_flags.trimming) {
+		if(s->slab_empty <= s->trim_high) {
+			return;
+		}
+		s->ms_flags.trimming = true;
+	}
+
+	DLIST_FOR_FWD(&(s->slab_list), cursor) {
+		slab = (memslab_t *) cursor;
+		if(slab->nfree == slab->ncells) {
+			memslab_release(s, slab);
+			break;
+		}
+	}
+
+	if(s->slab_empty <= s->trim_low) {
+		s->ms_flags.trimming = false;
+	}
+}
+
+void *memory_request(memory_state_t *s, size_t len)
+{
+	unsigned int cls;
+	memclass_t *c;
+	mclink_t *free_list;
+	memslab_t *slab;
+	memcell_t *mc;
+	DBGSTMT(char buf[21]);
+	DBGSTMT(char buf2[21]);
+	DBGSTMT(char buf3[21]);
+	DBGSTMT(char buf4[21]);
+
+	/* cell data length is rounded up to its class, which also keeps every
+	   cell aligned for the largest scalar type */
+	assert(len <= MEMORY_CELL_MAX_LEN);
+	cls = len ? (len - 1) / MEMORY_CLASS_GRANULE : 0;
+	if(s->ms_flags.region) {
+		c = &(s->region_classes[cls]);
+	} else {
+		c = &(s->classes[cls]);
+	}
+	free_list = &(c->free_list);
+
+	memstate_pace(s, sizeof(memcell_t) + (cls + 1) * MEMORY_CLASS_GRANULE);
+	if(mclist_is_empty(free_list) && memslab_exhausted(c)) {
+		memstate_pressure(s, MEMORY_SLAB_LEN);
+	}
+
+	if(! mclist_is_empty(free_list)) {
+		mc = (memcell_t *) mclink_remove(mclist_first(free_list));
+		slab = memcell_slab(mc);
+		if(slab->nfree-- == slab->ncells) {
+			s->slab_empty--;
+		}
+		assert(! memcell_locked(mc));
+		//assert(! memcell_refcount(mc)); // why not enable?
+#if ! defined(NO_GC_STATISTICS)
+		assert(s->total_free);
+		s->total_free--;
+#endif /* ! defined(NO_GC_STATISTICS) */
+		DBGTRACELN(TC_MEM_ALLOC,
+		           "gc (", fmt_u64d(buf, s->iter_count), "): ",
+		           "reuse node ", fmt_ptr(buf2, mc), " ",
+		           "(", fmt_ptr(buf3, mc->data), ") ",
+		           "nfree=", fmt_u64d(buf4, s->total_free));
+	} else {
+		mc = memslab_carve(s, c, cls);
+#if ! defined(NO_GC_STATISTICS)
+		s->total_alloc++;
+#endif /* ! defined(NO_GC_STATISTICS) */
+		DBGTRACELN(TC_MEM_ALLOC,
+		           "gc (", fmt_u64d(buf, s->iter_count), "): ",
+		           "carve node ", fmt_ptr(buf2, mc), " ",
+		           "(", fmt_ptr(buf3, mc->data), ") ",
+		           "nalloc=", fmt_u64d(buf4, s->total_alloc));
+	}
+
+	memcell_init(s, mc);
+	return mc->data;
+}
+#else /* defined(NO_GC_FREELIST) */
+void *memory_request(memory_state_t *s, size_t len)
+{
+	memslab_t *slab;
+	memcell_t *mc;
+
+	assert(len <= MEMORY_CELL_MAX_LEN);
+	memstate_pace(s, sizeof(memcell_t) + len);
+	/* every cell gets a slab of its own, so it can still find its state */
+	memstate_pressure(s, sizeof(memslab_t) + sizeof(memcell_t) + len);
+	slab = s->mem_alloc(sizeof(memslab_t) + sizeof(memcell_t) + len,
+	                    s->mem_alloc_priv);
+	/* there are no slabs to hold one back from */
+	if(! slab) {
+		memstate_alloc_fatal(sizeof(memslab_t) + sizeof(memcell_t) + len);
+	}
+	memstate_grow(s, sizeof(memslab_t) + sizeof(memcell_t) + len);
+	slab->state = s;
+	slab->id = 0;
+	slab->cls = 0;
+	slab->cell_len = sizeof(memcell_t) + len;
+	slab->ncells = slab->capacity = 1;
+	slab->nfin = 0;
+	mc = (memcell_t *) slab->cells;
+	memcell_set_slab(mc, slab);
+	memcell_init(s, mc);
+	s->total_alloc++;
+	return mc->data;
+}
+#endif /* ! defined(NO_GC_FREELIST) */
+
+bool memory_set_finalizer(void *data, data_fin_t fin)
+{
+	memcell_t *mc = data_to_memcell(data);
+	memory_state_t *s = memcell_slab(mc)->state;
+	unsigned int i;
+
+	if(! fin) {
+		memcell_set_fin_index(mc, 0);
+		return true;
+	}
+	/* finalizers are few; find this one or register it */
+	for(i = 1; i < MEMORY_FIN_MAX; i++) {
+		if(s->fin_table[i] == fin) {
+			break;
+		}
+		if(! s->fin_table[i]) {
+			s->fin_table[i] = fin;
+			break;
+		}
+	}
+	/* an index past the field would spill into the mark bit */
+	if(i == MEMORY_FIN_MAX) {
+		return false;
+	}
+	memcell_set_fin_index(mc, i);
+	return true;
+}
+
+void *memory_large_request(memory_state_t *s, size_t len)
+{
+	memlarge_t *lo;
+	size_t page = sysconf(_SC_PAGESIZE);
+	DBGSTMT(char buf[21]);
+	DBGSTMT(char buf2[21]);
+
+	len = (MEMORY_LARGE_HDR_LEN + len + page - 1) & ~(page - 1);
+	memstate_pace(s, len);
+	memstate_pressure(s, len);
+	lo = mmap(NULL, len, PROT_READ | PROT_WRITE,
+	          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if(lo == MAP_FAILED) {
+		return NULL;
+	}
+	memstate_grow(s, len);
+	dlnode_init(&(lo->hdr));
+	dlist_insertlast(&(s->large_list), &(lo->hdr));
+	lo->len = len;
+	s->large_len += len;
+	DBGTRACELN(TC_MEM_ALLOC,
+	           "gc: large object ", fmt_ptr(buf, lo), " ",
+	           "len=", fmt_u64d(buf2, len));
+	return (char *) lo + MEMORY_LARGE_HDR_LEN;
+}
+
+static void memlarge_unmap(memory_state_t *s, memlarge_t *lo)
+{
+	DBGSTMT(char buf[21]);
+
+	dlnode_remove(&(lo->hdr));
+	s->large_len -= lo->len;
+	s->heap_len -= lo->len;
+	DBGTRACELN(TC_MEM_ALLOC, "gc: unmap large object ", fmt_ptr(buf, lo));
+	munmap(lo, lo->len);
+}
+
+void memory_large_return(memory_state_t *s, void *addr)
+{
+	if(! addr) {
+		return;
+	}
+	memlarge_unmap(s, (memlarge_t *) ((char *) addr - MEMORY_LARGE_HDR_LEN));
+}
+
+bool memory_gc_is_locked(void *data)
+{
+	if(data) {
+		return memcell_locked(data_to_memcell(data));
+	} else {
+		return false;
+	}
+}
+
+void memory_gc_lock(memory_state_t *s, void *data)
+{
+	/* set locked state and make root */
+
+	DBGSTMT(char buf[21];)
+
+	memcell_t *mc = data_to_memcell(data);
+	memcell_lock(mc);
+	if(memcell_list(mc) != MC_LIST_ROOT) {
+		DBGTRACE(TC_GC_TRACING, "gc: add root ", fmt_ptr(buf, mc), " ");
+		DBGRUN(TC_GC_TRACING, { s->p_cb(mc->data, dbgtrace_getstream()); });
+		memcell_remove(s, mc);
+		memcell_to_roots_unproc(s, mc);
+	} else {
+		DBGTRACE(TC_GC_TRACING, "gc: add root ", fmt_ptr(buf, mc), " (noop) ");
+		DBGRUN(TC_GC_TRACING, { s->p_cb(mc->data, dbgtrace_getstream()); });
+	}
+}
+
+void memory_gc_unlock(memory_state_t *s, void *data)
+{
+	/* clear lock, make boundary if referenced, else make free_pending */
+	DBGSTMT(char buf[21];);
+
+	memcell_t *mc = data_to_memcell(data);
+	assert(memcell_is_root(s, mc));
+	memory_gc_rc_flush(s); /* the refcount decides where it goes */
+
+	DBGTRACE(TC_GC_TRACING, "gc: rem root ", fmt_ptr(buf, mc), " ");
+	DBGRUN(TC_GC_TRACING, { s->p_cb(mc->data, dbgtrace_getstream()); });
+
+	memcell_remove(s, mc);
+	if(memcell_refcount(mc)) {
+		memcell_to_boundary(s, mc);
+	} else {
+		memcell_to_free_pending(s, mc);
+	}
+	memcell_unlock(mc);
+	s->clean_cycles = 0; // may need to begin cleanup
+}
+
+/* pull a cell being linked to out of the unprocessed set if applicable.
+   'boundaries' and 'reachables' are self-evidently unnecessary
+   'roots' will be taken care of eventually during GC iteration
+   if we don't do this, we may lose an 'unprocessed' node if:
+   - it is being linked to by a root node that has already been 'processed'
+   - and it is being unlnked from a nonroot that is not 'processed' */
+static void memcell_link_barrier(memory_state_t *s, memcell_t *mc)
+{
+	assert(! memcell_is_free(s, mc));
+	assert(! memcell_is_free_pending(s, mc));
+	if(memcell_is_unproc(s, mc)) {
+		memcell_to_boundary(s, mc);
+	}
+}
+
+/* the refcount of an unlocked cell dropped to zero */
+static void memcell_unreferenced(memory_state_t *s, memcell_t *mc)
+{
+	if(! memcell_refcount(mc)
+	   && ! memcell_locked(mc)
+	   && ! memcell_is_free(s, mc) /* if loop node may already be in free */
+	   && ! memcell_is_doomed(s, mc)) {
+		memcell_remove(s, mc);
+		memcell_to_free_pending(s, mc);
+	}
+}
+
+/* decrease refcount, move to free_pending unreferenced and not locked */
+static void memcell_stale_link(memory_state_t *s, memcell_t *mc)
+{
+	DBGSTMT(char buf[21]);
+	DBGSTMT(char buf2[21]);
+	DBGSTMT(char buf3[21]);
+
+	s->clean_cycles = 0; // may need to begin cleanup
+	if(! memcell_refcount(mc)) { // may already be zero if there is a loop
+		DBGTRACELN(TC_MEM_RC,
+		           "gc: ", fmt_ptr(buf, mc), " ",
+		           "(", fmt_ptr(buf2, mc->data), ") ",
+		           "refcount-- 0 -> 0 (loop?)");
+		/* unreferenced nodes shouldn't be live */
+		assert(memcell_is_free_pending(s, mc) ||
+		       memcell_is_free(s, mc) ||
+		       memcell_is_doomed(s, mc));
+		return;
+	}
+	memcell_decref(mc);
+	DBGTRACELN(TC_MEM_RC,
+	           "gc: ", fmt_ptr(buf, mc), " ",
+	           "(", fmt_ptr(buf2, mc->data), ") ",
+	           "refcount-- -> ", fmt_u64d(buf3, memcell_refcount(mc)));
+	if(memcell_refcount(mc)) {
+		memcell_cycle_suspect(s, mc);
+	}
+	memcell_unreferenced(s, mc);
+}
+
+#if defined(GC_DEFERRED_RC)
+static uintptr_t memstate_rc_hash(memcell_t *mc)
+{
+	return (uint32_t) ((uintptr_t) mc * 2654435761u)
+	       >> (32 - MEMORY_RC_LOG_BITS);
+}
+
+/* add delta to the logged refcount change of mc */
+static void memstate_rc_log(memory_state_t *s, memcell_t *mc, int32_t delta)
+{
+	uintptr_t i = memstate_rc_hash(mc);
+	memrc_entry_t *e;
+
+	for(;;) {
+		e = &(s->rc_log[i]);
+		if(e->mc == mc) {
+			e->delta += delta;
+			return;
+		}
+		if(! e->mc) {
+			break;
+		}
+		i = (i + 1) & (MEMORY_RC_LOG_LEN - 1);
+	}
+	e->mc = mc;
+	e->delta = delta;
+	s->rc_log_used[s->rc_log_count++] = i;
+	/* flushing early keeps the probe sequences short */
+	if(s->rc_log_count >= MEMORY_RC_LOG_LEN / 4 * 3) {
+		memory_gc_rc_flush(s);
+	}
+}
+
+/* apply the net refcount change logged for mc. A net change of 0 still had
+   a decrement in it, which may have been the last link. */
+static void memcell_rc_apply(memory_state_t *s, memcell_t *mc, int32_t delta)
+{
+	DBGSTMT(char buf[21]);
+	DBGSTMT(char buf2[21]);
+	DBGSTMT(char buf3[21]);
+
+	if(delta && memcell_refcount(mc) < MC_RC_MAX) {
+		assert(delta > 0 || memcell_refcount(mc) >= (uintptr_t) -delta);
+		/* saturate rather than wrap, as memcell_incref() does */
+		if(delta > 0
+		   && MC_RC_MAX - memcell_refcount(mc) < (uintptr_t) delta) {
+			delta = MC_RC_MAX - memcell_refcount(mc);
+		}
+		MC_SET(mc->rc_flags,
+		       MC_GET(mc->rc_flags) + (uint32_t) delta * MC_RC_ONE);
+		s->rc_applied++;
+		DBGTRACELN(TC_MEM_RC,
+		           "gc: ", fmt_ptr(buf, mc), " ",
+		           "(", fmt_ptr(buf2, mc->data), ") ",
+		           "refcount (logged) -> ",
+		           fmt_u64d(buf3, memcell_refcount(mc)));
+	}
+	if(delta <= 0 && memcell_refcount(mc)) {
+		memcell_cycle_suspect(s, mc);
+	}
+	memcell_unreferenced(s, mc);
+}
+#endif /* defined(GC_DEFERRED_RC) */
+
+#if defined(GC_CONCURRENT_MARK)
+void memory_gc_overwrite_barrier(memory_state_t *s, void *old)
+{
+	memcell_t *mc;
+
+	/* the insertion barrier of memory_gc_advise_new_link() suffices for
+	   the GC steps, which see no link change in the middle of tracing */
+	if(! old || ! s->mark_running) {
+		return;
+	}
+	mc = data_to_memcell(old);
+	if(memcell_is_unproc(s, mc)) {
+		memcell_to_boundary(s, mc);
+	}
+}
+#endif /* defined(GC_CONCURRENT_MARK) */
+
+void memory_gc_rc_flush(memory_state_t *s)
+{
+#if defined(GC_DEFERRED_RC)
+	memrc_entry_t *e;
+	uintptr_t i;
+
+	for(i = 0; i < s->rc_log_count; i++) {
+		e = &(s->rc_log[s->rc_log_used[i]]);
+		memcell_rc_apply(s, e->mc, e->delta);
+		e->mc = NULL;
+	}
+	s->rc_log_count = 0;
+#else
+	(void) s;
+#endif /* defined(GC_DEFERRED_RC) */
+}
+
+void memory_gc_advise_new_link(memory_state_t *s, void *data)
+{
+	/* increase refcount, move to 'boundary' if 'unprocessed' */
+
+	memcell_t *mc;
+	DBGSTMT(char buf[21]);
+	DBGSTMT(char buf2[21]);
+	DBGSTMT(char buf3[21]);
+
+	if(!data) {
+		return;
+	}
+	mc = data_to_memcell(data);
+	s->rc_advised++;
+	/* even when the refcount is left for later, tracing has to see the link
+	   now */
+	memcell_link_barrier(s, mc);
+#if defined(GC_DEFERRED_RC)
+	memstate_rc_log(s, mc, 1);
+#else
+	memcell_incref(mc);
+	s->rc_applied++;
+	DBGTRACELN(TC_MEM_RC,
+	           "gc: ", fmt_ptr(buf, mc), " ",
+	           "(", fmt_ptr(buf2, mc->data), ") ",
+	           "refcount++ -> ", fmt_u64d(buf3, memcell_refcount(mc)));
+#endif /* defined(GC_DEFERRED_RC) */
+}
+
+void memory_gc_advise_stale_link(memory_state_t *s, void *data)
+{
+	if(!data) {
+		return;
+	}
+	s->rc_advised++;
+#if defined(GC_DEFERRED_RC)
+	s->clean_cycles = 0; // may need to begin cleanup
+	memstate_rc_log(s, data_to_memcell(data), -1);
+#else
+	s->rc_applied++;
+	memcell_stale_link(s, data_to_memcell(data));
+#endif /* defined(GC_DEFERRED_RC) */
+}
+
+void memory_gc_write_barrier(memory_state_t *s, void *holder, void *data)
+{
+	memcell_t *mc;
+
+	if(!data) {
+		return;
+	}
+	/* old-to-young links make the young cell a root of the next nursery
+	   collection */
+	mc = data_to_memcell(data);
+	if(memcell_is_young(mc) && ! memcell_is_young(data_to_memcell(holder))) {
+		memcell_flags_set(mc, MC_FLAG_REMEMBERED);
+	}
+#if ! defined(NO_GC_FREELIST)
+	/* region cells stored into older cells escape the region */
+	if(s->ms_flags.region
+	   && memcell_slab(mc)->region
+	   && ! memcell_slab(data_to_memcell(holder))->region) {
+		memcell_flags_set(mc, MC_FLAG_EXPORTED);
+	}
+#else
+	(void) s;
+#endif /* ! defined(NO_GC_FREELIST) */
+}
+
+void memory_gc_roots_push(memory_state_t *s, void **slots, uintptr_t n)
+{
+	void ***shadow;
+	uintptr_t i;
+
+	if(s->shadow_len + n > s->shadow_cap) {
+		if(! s->shadow_cap) {
+			s->shadow_cap = MEMORY_SHADOW_MIN_LEN;
+		}
+		while(s->shadow_len + n > s->shadow_cap) {
+			s->shadow_cap *= 2;
+		}
+		shadow = s->mem_alloc(s->shadow_cap * sizeof(*shadow),
+		                      s->mem_alloc_priv);
+		assert(shadow);
+		for(i = 0; i < s->shadow_len; i++) {
+			shadow[i] = s->shadow[i];
+		}
+		if(s->shadow) {
+			s->mem_free(s->shadow, s->mem_alloc_priv);
+		}
+		s->shadow = shadow;
+	}
+	for(i = 0; i < n; i++) {
+		slots[i] = NULL;
+		s->shadow[s->shadow_len++] = &(slots[i]);
+	}
+}
+
+void memory_gc_roots_pop(memory_state_t *s, void **slots, uintptr_t n)
+{
+	uintptr_t i;
+
+	assert(s->shadow_len >= n);
+	for(i = 0; i < n; i++) {
+		assert(s->shadow[s->shadow_len - n + i] == &(slots[i]));
+		memory_gc_root_set(s, &(slots[i]), NULL);
+	}
+	s->shadow_len -= n;
+}
+
+void memory_gc_root_set(memory_state_t *s, void **slot, void *data)
+{
+	void *old = *slot;
+	memcell_t *mc;
+
+	memory_gc_overwrite_barrier(s, old);
+	memory_gc_advise_new_link(s, data);
+	/* the nursery collection does not scan the slots, so young cells held
+	   in one are remembered as if an older cell linked to them. Region
+	   cells held in one are found by the region release instead. */
+	if(data) {
+		mc = data_to_memcell(data);
+		if(memcell_is_young(mc)) {
+			memcell_flags_set(mc, MC_FLAG_REMEMBERED);
+		}
+	}
+	*slot = data;
+	memory_gc_advise_stale_link(s, old);
+}
+
+bool memory_gc_isroot(memory_state_t *s, void *data)
+{
+	bool status;
+	memcell_t *mc;
+	if(!data) {
+		return false;
+	}
+	mc = data_to_memcell(data);
+	status = memcell_is_root(s, mc);
+	return status;
+}
+
+bool memory_gc_islive(memory_state_t *s, void *data)
+{
+	memcell_t *mc;
+	if(!data) {
+		return false;
+	}
+	mc = data_to_memcell(data);
+	return !memcell_is_free(s, mc);
+}
+
+static void dl_cb_try_move_boundary(void *link, void *p)
+{
+	/* move to boundary if unprocessed, or an unlocked root */
+	DBGSTMT(char buf[21];)
+
+	memory_state_t *s = (memory_state_t *) p;
+	memcell_t *mc;
+
+	if(!link) {
+		DBGTRACELN(TC_GC_TRACING,"gc: move boundary null (noop)");
+		return;
+	}
+	mc = data_to_memcell(link);
+
+	/* linked data should never be in the free or free_pending list */
+	assert(! memcell_is_free(s, mc));
+	assert(! memcell_is_free_pending(s, mc));
+	/* linked data should be referenced */
+	assert(memcell_refcount(mc));
+
+	if(memcell_is_unproc(s, mc)){
+		DBGTRACE(TC_GC_TRACING,
+		         "gc: move boundary unproc ", fmt_ptr(buf, mc), " ");
+		DBGRUN(TC_GC_TRACING, { s->p_cb(mc->data, dbgtrace_getstream()); });
+		memcell_to_boundary(s, mc);
+	} else if(memcell_is_root(s, mc)) {
+		DBGTRACE(TC_GC_TRACING,
+		         "gc: move boundary root ", fmt_ptr(buf, mc), 
+		         (memcell_locked(mc) ? " (L)" : " "));
+		DBGRUN(TC_GC_TRACING, { s->p_cb(mc->data, dbgtrace_getstream()); });
+		if(! memcell_locked(mc)) {
+			memcell_remove(s, mc);
+			memcell_to_boundary(s, mc);
+		}
+	} else {
+		DBGTRACE(TC_GC_TRACING,
+		         "gc: move boundary noop ", fmt_ptr(buf, mc), " ");
+		DBGRUN(TC_GC_TRACING, { s->p_cb(mc->data, dbgtrace_getstream()); });
+	}
+}
+
+/* the root slots are traced like a root cell, all at once. Links stored in
+   them later go through the link barrier. */
+static void memstate_shadow_scan(memory_state_t *s)
+{
+	uintptr_t i;
+
+	for(i = 0; i < s->shadow_len; i++) {
+		dl_cb_try_move_boundary(*(s->shadow[i]), s);
+	}
+	s->ms_flags.shadow_scanned = true;
+}
+
+static void dl_cb_decref_free_pending_z(void *link, void *p)
+{
+	memory_state_t *s = (memory_state_t *) p;
+	if(link) {
+		memcell_stale_link(s, data_to_memcell(link));
+	}
+}
+
+/* links between unreachable cells are left alone: the sweep frees them all */
+static void dl_cb_sweep_unlink(void *link, void *p)
+{
+	memory_state_t *s = (memory_state_t *) p;
+
+	if(link && ! memcell_is_doomed(s, data_to_memcell(link))) {
+		memcell_stale_link(s, data_to_memcell(link));
+	}
+}
+
+static void dl_cb_minor_reach(void *link, void *p)
+{
+	mclink_t *reached = (mclink_t *) p;
+	memcell_t *mc;
+
+	if(!link) {
+		return;
+	}
+	mc = data_to_memcell(link);
+	if(memcell_is_young(mc)) {
+		mclink_remove(&(mc->hdr));
+		memcell_set_list(mc, MC_LIST_NONE);
+		mclist_insertlast(reached, &(mc->hdr));
+	}
+}
+
+static void dl_cb_minor_release(void *link, void *p)
+{
+	memory_state_t *s = (memory_state_t *) p;
+
+	/* young cells still in the nursery are freed along with the linker */
+	if(link && ! memcell_is_young(data_to_memcell(link))) {
+		memcell_stale_link(s, data_to_memcell(link));
+	}
+}
+
+void memory_gc_minor(memory_state_t *s)
+{
+	mclink_t reached, dead, *cursor, *next;
+	memcell_t *mc;
+	/* a GC step collects the nursery too */
+	bool active = memstate_isactive(s);
+	DBGSTMT(char buf[21]);
+	DBGSTMT(char buf2[21]);
+	DBGSTMT(unsigned long long promoted = s->promoted_count);
+	DBGSTMT(unsigned long long freed = s->young_free_count);
+
+	mclist_init(&reached);
+	mclist_init(&dead);
+	memstate_setactive(s);
+	memory_gc_rc_flush(s);
+
+	/* young cells that were never linked may still be held by the C stack,
+	   and remembered cells are linked from older cells: both are roots */
+	for(cursor = mclist_first(&(s->nursery_list));
+	    cursor != &(s->nursery_list);
+	    cursor = next) {
+		next = cursor->next;
+		mc = (memcell_t *) cursor;
+		if(! memcell_refcount(mc) || (MC_GET(mc->rc_flags) & MC_FLAG_REMEMBERED)) {
+			dl_cb_minor_reach(&(mc->data), &reached);
+		}
+	}
+
+	/* young cells linked from reached ones are appended behind the cursor
+	   and so get walked as well */
+	MCLIST_FOR_FWD(&reached, cursor) {
+		MEMSTATE_LINKS(s, dl_cb_minor_reach, &(((memcell_t *) cursor)->data),
+		               &reached);
+	}
+
+	/* promote survivors into the incremental heap */
+	while(! mclist_is_empty(&reached)) {
+		mc = (memcell_t *) mclink_remove(mclist_first(&reached));
+		memcell_flags_clear(mc, MC_FLAG_REMEMBERED);
+		if(memcell_refcount(mc)) {
+			memcell_to_boundary(s, mc);
+		} else {
+			memcell_to_roots_unproc(s, mc);
+		}
+		s->nursery_count--;
+		s->promoted_count++;
+		/* promoted cells survive the cycle in progress, garbage or not */
+		s->clean_cycles = 0;
+	}
+
+	/* the rest is only linked from other unreachable young cells. It leaves
+	   the nursery before it is freed, as the cells a finalizer requests
+	   join it. */
+	MCLIST_FOR_FWD(&(s->nursery_list), cursor) {
+		MEMSTATE_LINKS(s, dl_cb_minor_release, &(((memcell_t *) cursor)->data), s);
+	}
+	while(! mclist_is_empty(&(s->nursery_list))) {
+		mc = (memcell_t *) mclink_remove(mclist_first(&(s->nursery_list)));
+		memcell_set_list(mc, MC_LIST_NONE);
+		mclist_insertlast(&dead, &(mc->hdr));
+		s->nursery_count--;
+	}
+	assert(! s->nursery_count);
+	while(! mclist_is_empty(&dead)) {
+		mc = (memcell_t *) mclist_first(&dead);
+#if defined(GC_REACHABILITY_VERIFICATION)
+		assert(!memcell_reachable(s, mc));
+#endif
+		assert(! memcell_locked(mc));
+		memcell_free(s, mc);
+		s->young_free_count++;
+	}
+
+	if(! active) {
+		memstate_resetactive(s);
+	}
+	s->minor_count++;
+	DBGTRACELN(TC_GC_TRACING,
+	           "gc minor: promoted ",
+	           fmt_u64d(buf, s->promoted_count - promoted), " ",
+	           "freed ", fmt_u64d(buf2, s->young_free_count - freed));
+}
+
+#if ! defined(NO_GC_FREELIST)
+/* cells of the scratch region still to be walked for exports */
+struct region_walk
+{
+	memory_state_t *s;
+	memcell_t **stack;
+	uintptr_t len, cap;
+};
+
+static bool memcell_in_region(memcell_t *mc)
+{
+	return memcell_slab(mc)->region;
+}
+
+static void region_walk_push(struct region_walk *w, memcell_t *mc)
+{
+	memcell_t **stack;
+	uintptr_t i;
+
+	memcell_flags_set(mc, MC_FLAG_EXPORTED);
+	if(w->len == w->cap) {
+		w->cap = w->cap ? w->cap * 2 : 64;
+		stack = w->s->mem_alloc(w->cap * sizeof(*stack), w->s->mem_alloc_priv);
+		assert(stack);
+		for(i = 0; i < w->len; i++) {
+			stack[i] = w->stack[i];
+		}
+		if(w->stack) {
+			w->s->mem_free(w->stack, w->s->mem_alloc_priv);
+		}
+		w->stack = stack;
+	}
+	w->stack[w->len++] = mc;
+}
+
+static void dl_cb_region_export(void *link, void *p)
+{
+	memcell_t *mc;
+
+	if(!link) {
+		return;
+	}
+	mc = data_to_memcell(link);
+	if(memcell_in_region(mc) && ! (MC_GET(mc->rc_flags) & MC_FLAG_EXPORTED)) {
+		region_walk_push((struct region_walk *) p, mc);
+	}
+}
+
+/* region cells dropped by this release are freed without their links */
+static bool memcell_region_dropped(memcell_t *mc)
+{
+	return memcell_in_region(mc)
+	       && memcell_live(mc)
+	       && memcell_list(mc) != MC_LIST_FINALIZE
+	       && ! (MC_GET(mc->rc_flags) & MC_FLAG_EXPORTED);
+}
+
+static void dl_cb_region_unlink(void *link, void *p)
+{
+	memory_state_t *s = (memory_state_t *) p;
+
+	if(link && ! memcell_region_dropped(data_to_memcell(link))) {
+		memcell_stale_link(s, data_to_memcell(link));
+	}
+}
+
+/* take the cells about to be dropped off the worklist */
+static void memstate_worklist_drop_region(memory_state_t *s)
+{
+	memchunk_t **link = &(s->worklist), *chunk;
+	uintptr_t i, len;
+
+	while((chunk = *link)) {
+		len = 0;
+		for(i = 0; i < chunk->len; i++) {
+			if(memcell_region_dropped(chunk->cells[i])) {
+				memcell_meta_clear(chunk->cells[i], MC_QUEUED_BIT);
+			} else {
+				chunk->cells[len++] = chunk->cells[i];
+			}
+		}
+		s->worklist_len -= chunk->len - len;
+		chunk->len = len;
+		if(len) {
+			link = &(chunk->next);
+		} else {
+			*link = chunk->next;
+			s->mem_free(chunk, s->mem_alloc_priv);
+		}
+	}
+}
+#endif /* ! defined(NO_GC_FREELIST) */
+
+void memory_region_begin(memory_state_t *s)
+{
+	assert(! s->ms_flags.region);
+	s->ms_flags.region = true;
+}
+
+void memory_region_export(memory_state_t *s, void *data)
+{
+	(void) s;
+	if(!data) {
+		return;
+	}
+	memcell_flags_set(data_to_memcell(data), MC_FLAG_EXPORTED);
+}
+
+void memory_region_release(memory_state_t *s)
+{
+#if ! defined(NO_GC_FREELIST)
+	struct region_walk w = { s, NULL, 0, 0 };
+	dlnode_t *cursor, *next;
+	memslab_t *slab;
+	memcell_t *mc;
+	uintptr_t i, freed = 0;
+	DBGSTMT(char buf[21]);
+
+	assert(s->ms_flags.region);
+	s->ms_flags.region = false;
+	memory_gc_rc_flush(s);
+#if defined(GC_CONCURRENT_MARK)
+	/* the marker must not be tracing the cells about to be freed */
+	if(s->mark_running) {
+		memstate_marker_sync(s);
+	}
+#endif /* defined(GC_CONCURRENT_MARK) */
+
+	/* everything reachable from locked or exported region cells survives */
+	DLIST_FOR_FWD(&(s->slab_list), cursor) {
+		slab = (memslab_t *) cursor;
+		if(! slab->region) {
+			continue;
+		}
+		for(i = 0; i < slab->ncells; i++) {
+			mc = memslab_cell(slab, i);
+			if(memcell_live(mc)
+			   && (MC_GET(mc->rc_flags) & (MC_FLAG_EXPORTED | MC_FLAG_LOCKED))) {
+				region_walk_push(&w, mc);
+			}
+		}
+	}
+	/* and from the root slots */
+	for(i = 0; i < s->shadow_len; i++) {
+		dl_cb_region_export(*(s->shadow[i]), &w);
+	}
+	while(w.len) {
+		mc = w.stack[--w.len];
+		MEMSTATE_LINKS(s, dl_cb_region_export, &(mc->data), &w);
+	}
+	if(w.stack) {
+		s->mem_free(w.stack, s->mem_alloc_priv);
+	}
+	memstate_worklist_drop_region(s);
+
+	/* drop the links the rest holds to survivors and older cells, while all
+	   of it is still intact, then free it */
+	DLIST_FOR_FWD(&(s->slab_list), cursor) {
+		slab = (memslab_t *) cursor;
+		if(! slab->region) {
+			continue;
+		}
+		for(i = 0; i < slab->ncells; i++) {
+			mc = memslab_cell(slab, i);
+			if(memcell_region_dropped(mc)) {
+				MEMSTATE_LINKS(s, dl_cb_region_unlink, &(mc->data), s);
+			}
+		}
+	}
+	DLIST_FOR_FWD(&(s->slab_list), cursor) {
+		slab = (memslab_t *) cursor;
+		if(! slab->region) {
+			continue;
+		}
+		for(i = 0; i < slab->ncells; i++) {
+			mc = memslab_cell(slab, i);
+			if(memcell_region_dropped(mc)) {
+				if(memcell_is_young(mc)) {
+					s->nursery_count--;
+				}
+				memcell_set_list(mc, MC_LIST_NONE);
+				memcell_free(s, mc);
+				freed++;
+			}
+			memcell_flags_clear(mc, MC_FLAG_EXPORTED);
+		}
+	}
+
+	/* empty slabs go back to the allocator, the others join the heap */
+	for(cursor = dlist_first(&(s->slab_list));
+	    ! dlnode_is_terminal(cursor);
+	    cursor = next) {
+		next = dlnode_next(cursor);
+		slab = (memslab_t *) cursor;
+		if(! slab->region) {
+			continue;
+		}
+		if(slab->nfree == slab->ncells) {
+			memslab_release(s, slab);
+			continue;
+		}
+		slab->region = false;
+		for(i = 0; i < slab->ncells; i++) {
+			mc = memslab_cell(slab, i);
+			if(memcell_list(mc) == MC_LIST_FREE) {
+				mclink_remove(&(mc->hdr));
+				mclist_insertlast(&(memslab_class(s, slab)->free_list),
+				                  &(mc->hdr));
+			}
+		}
+	}
+	for(i = 0; i < MEMORY_SIZE_CLASSES; i++) {
+		assert(mclist_is_empty(&(s->region_classes[i].free_list)));
+		s->region_classes[i].slab_cur = NULL;
+	}
+
+	s->region_freed += freed;
+	s->clean_cycles = 0;
+	DBGTRACELN(TC_GC_TRACING,
+	           "gc region release: freed ", fmt_u64d(buf, freed));
+#else /* defined(NO_GC_FREELIST) */
+	assert(s->ms_flags.region);
+	s->ms_flags.region = false;
+#endif /* ! defined(NO_GC_FREELIST) */
+}
+
+/* unlink an unprocessed cell found by the sweep and put it on the doomed
+   list. Nothing is freed until the sweep is over, as unreachable cells may
+   still link to each other. */
+static void memstate_sweep_doom(memory_state_t *s, memcell_t *mc)
+{
+	DBGSTMT(char buf[21]);
+	DBGSTMT(char buf2[21]);
+
+#if defined(GC_REACHABILITY_VERIFICATION)
+	assert(!memcell_reachable(s, mc));
+#endif
+	DBGTRACE(TC_GC_TRACING,
+	         "gc (", fmt_u64d(buf, s->iter_count), ") ",
+	         "iter unreachable: ", fmt_ptr(buf2, mc), " ");
+	DBGRUN(TC_GC_TRACING, { s->p_cb(mc->data, dbgtrace_getstream()); });
+	assert(! memcell_locked(mc)); // locked nodes should stay in root list
+	assert(! (MC_GET(mc->meta) & MC_QUEUED_BIT)); // queued cells are marked
+	// NB: unreachable can be referenced if e.g. lambda points back to it.
+	MEMSTATE_LINKS(s, dl_cb_sweep_unlink, &(mc->data), s);
+	memcell_remove(s, mc);
+	mclist_insertlast(&(s->doomed_list), &(mc->hdr));
+	memcell_set_list(mc, MC_LIST_DOOMED);
+}
+
+/* free a cell doomed by the sweep, its links are already dropped */
+static void memstate_doomed_free(memory_state_t *s, memcell_t *mc)
+{
+	DBGSTMT(char buf[21]);
+	DBGSTMT(char buf2[21]);
+	DBGSTMT(char buf3[21]);
+
+	memcell_free(s, mc);
+#if defined(NO_GC_FREELIST)
+	DBGTRACELN(TC_MEM_ALLOC,
+	         "gc (", fmt_u64d(buf, s->iter_count), "): ",
+	         "free node (unreachable) ", fmt_ptr(buf2, mc));
+#else /* ! defined(NO_GC_FREELIST) */
+	DBGTRACELN(TC_MEM_ALLOC,
+	         "gc (", fmt_u64d(buf, s->iter_count), "): ",
+	         "free node (unreachable) ", fmt_ptr(buf2, mc), " ",
+	         "nfree=", fmt_u64d(buf3, s->total_free));
+	assert(s->total_free <= s->total_alloc);
+#endif /* ? defined(NO_GC_FREELIST) */
+}
+
+/* look at up to MEMORY_SWEEP_SCAN heap cells in address order, dooming the
+   first unprocessed one. Returns true once every slab has been swept. Cells
+   joining the heap meanwhile are marked, so the sweep never dooms them. The
+   sweeping flag stays set until the cycle is reset. */
+#if ! defined(NO_GC_FREELIST)
+static bool memstate_sweep(memory_state_t *s)
+{
+	memslab_t *slab;
+	memcell_t *mc;
+	unsigned int n;
+
+	if(! s->ms_flags.sweeping) {
+		s->ms_flags.sweeping = true;
+		s->sweep_slab = dlist_first(&(s->slab_list));
+		s->sweep_index = 0;
+	}
+	for(n = 0; n < MEMORY_SWEEP_SCAN; ) {
+		if(dlnode_is_terminal(s->sweep_slab)) {
+			return true;
+		}
+		slab = (memslab_t *) s->sweep_slab;
+		if(s->sweep_index == slab->ncells) {
+			s->sweep_slab = dlnode_next(s->sweep_slab);
+			s->sweep_index = 0;
+			continue;
+		}
+		mc = memslab_cell(slab, s->sweep_index++);
+		n++;
+		if(memcell_is_unproc(s, mc)) {
+			memstate_sweep_doom(s, mc);
+			return false;
+		}
+	}
+	return false;
+}
+#else /* defined(NO_GC_FREELIST) */
+/* the sweep sentinel is moved through the heap list past each cell seen */
+static bool memstate_sweep(memory_state_t *s)
+{
+	mclink_t *next;
+	memcell_t *mc;
+	unsigned int n;
+
+	if(! s->ms_flags.sweeping) {
+		s->ms_flags.sweeping = true;
+		mclink_insert(&(s->heap_list), &(s->sweep_sentinel),
+		              s->heap_list.next);
+	}
+	for(n = 0; n < MEMORY_SWEEP_SCAN; n++) {
+		next = s->sweep_sentinel.next;
+		if(next == &(s->heap_list)) {
+			return true;
+		}
+		mc = (memcell_t *) next;
+		if(memcell_is_unproc(s, mc)) {
+			memstate_sweep_doom(s, mc);
+			return false;
+		}
+		mclink_remove(&(s->sweep_sentinel));
+		mclink_insert(next, &(s->sweep_sentinel), next->next);
+	}
+	return false;
+}
+#endif /* ! defined(NO_GC_FREELIST) */
+
+/* end of a cycle: every root and heap cell has been processed */
+static void memstate_cycle_reset(memory_state_t *s)
+{
+	/* reset state -- progress root_sentinel, flip the mark epoch so every
+	   heap cell is unprocessed again */
+	DBGTRACELN(TC_GC_TRACING, "gc iter ** done **: reset state");
+	assert(mclist_first(&(s->roots_list)) == &(s->root_sentinel));
+	assert(! s->worklist);
+	mclist_insertlast(&(s->roots_list),
+	                  mclink_remove(mclist_first(&(s->roots_list))));
+	s->mark_epoch ^= 1;
+#if defined(GC_CONCURRENT_MARK)
+	memstate_clear_marks(s);
+#endif /* defined(GC_CONCURRENT_MARK) */
+#if defined(NO_GC_FREELIST)
+	mclink_remove(&(s->sweep_sentinel));
+#else /* ! defined(NO_GC_FREELIST) */
+	s->sweep_slab = NULL;
+#endif /* defined(NO_GC_FREELIST) */
+	s->ms_flags.sweeping = false;
+	s->ms_flags.nursery_swept = false;
+	s->ms_flags.shadow_scanned = false;
+#if ! defined(NO_GC_STATISTICS)
+	s->cycle_count++;
+#endif
+	s->clean_cycles++;
+#if ! defined(NO_GC_FREELIST)
+	/* the free counts are settled at the end of a cycle, so trimming can
+	   make progress here too when the GC never gets to idle */
+	memslab_trim(s);
+#endif /* ! defined(NO_GC_FREELIST) */
+	memstate_adapt(s);
+}
+
+/* one GC step, returns true when a complete gc cycle has been completed */
+#if defined(GC_CYCLE_COLLECT)
+static uintptr_t memstate_trial_hash(memcell_t *mc)
+{
+	return (uint32_t) ((uintptr_t) mc * 2654435761u)
+	       & (2 * MEMORY_CYCLE_SCAN - 1);
+}
+
+/* the entry of a cell taken by the pass, or NULL */
+static memtrial_entry_t *memstate_trial_find(memory_state_t *s, memcell_t *mc)
+{
+	uintptr_t i;
+
+	for(i = memstate_trial_hash(mc);
+	    s->trial_table[i].mc;
+	    i = (i + 1) & (2 * MEMORY_CYCLE_SCAN - 1)) {
+		if(s->trial_table[i].mc == mc) {
+			return &(s->trial_table[i]);
+		}
+	}
+	return NULL;
+}
+
+struct trial
+{
+	memory_state_t *s;
+	uintptr_t len; /* cells taken */
+	memtrial_entry_t **stack; /* live cells whose links are to be followed */
+	uintptr_t depth;
+};
+
+/* only cells the GC steps could free are taken: a doomed one is left to
+   the sweep. A queued one is taken, and dropped from the worklist if found
+   dead (see memstate_trial_unqueue()). */
+static bool memcell_trial_takes(memory_state_t *s, memcell_t *mc)
+{
+	return memcell_list(mc) == MC_LIST_HEAP
+	       && ! memcell_locked(mc)
+	       && ! memcell_is_doomed(s, mc);
+}
+
+static void memstate_trial_take(struct trial *t, memcell_t *mc)
+{
+	memory_state_t *s = t->s;
+	uintptr_t i;
+
+	if(t->len == MEMORY_CYCLE_SCAN || ! memcell_trial_takes(s, mc)) {
+		return;
+	}
+	for(i = memstate_trial_hash(mc);
+	    s->trial_table[i].mc;
+	    i = (i + 1) & (2 * MEMORY_CYCLE_SCAN - 1)) {
+		if(s->trial_table[i].mc == mc) {
+			return;
+		}
+	}
+	s->trial_table[i].mc = mc;
+	s->trial_table[i].internal = 0;
+	s->trial_table[i].live = false;
+	s->trial_order[t->len++] = &(s->trial_table[i]);
+}
+
+static void dl_cb_trial_take(void *link, void *p)
+{
+	if(link) {
+		memstate_trial_take((struct trial *) p, data_to_memcell(link));
+	}
+}
+
+static void dl_cb_trial_count(void *link, void *p)
+{
+	memtrial_entry_t *e;
+
+	if(link && (e = memstate_trial_find((memory_state_t *) p,
+	                                    data_to_memcell(link)))) {
+		e->internal++;
+	}
+}
+
+static void memstate_trial_live(struct trial *t, memtrial_entry_t *e)
+{
+	if(! e->live) {
+		e->live = true;
+		t->stack[t->depth++] = e;
+	}
+}
+
+static void dl_cb_trial_live(void *link, void *p)
+{
+	struct trial *t = (struct trial *) p;
+	memtrial_entry_t *e;
+
+	if(link && (e = memstate_trial_find(t->s, data_to_memcell(link)))) {
+		memstate_trial_live(t, e);
+	}
+}
+
+/* a cell is never freed while on the worklist: drop the ones found dead
+   from it, instead of leaving them to the slow pace of the GC steps that
+   would pop them. A chunk left empty is freed, as popping expects none. */
+static void memstate_trial_unqueue(memory_state_t *s)
+{
+	memchunk_t **link = &(s->worklist), *chunk;
+	memtrial_entry_t *e;
+	uintptr_t i, len;
+
+	while((chunk = *link)) {
+		len = 0;
+		for(i = 0; i < chunk->len; i++) {
+			e = memstate_trial_find(s, chunk->cells[i]);
+			if(e && ! e->live) {
+				memcell_meta_clear(chunk->cells[i], MC_QUEUED_BIT);
+			} else {
+				chunk->cells[len++] = chunk->cells[i];
+			}
+		}
+		s->worklist_len -= chunk->len - len;
+		chunk->len = len;
+		if(len) {
+			link = &(chunk->next);
+		} else {
+			*link = chunk->next;
+			s->mem_free(chunk, s->mem_alloc_priv);
+		}
+	}
+}
+
+/* links between the cells found dead are left alone, they are all freed */
+static void dl_cb_trial_unlink(void *link, void *p)
+{
+	memory_state_t *s = (memory_state_t *) p;
+	memtrial_entry_t *e;
+	memcell_t *mc;
+
+	if(! link) {
+		return;
+	}
+	mc = data_to_memcell(link);
+	e = memstate_trial_find(s, mc);
+	if((e && ! e->live) || memcell_is_doomed(s, mc)) {
+		return;
+	}
+	memcell_stale_link(s, mc);
+}
+
+/* trial deletion over the logged candidates, returns false if it could not
+   run at this point. The cells freed are left in *freed. */
+static bool memstate_trial_deletion(memory_state_t *s, uintptr_t *freed)
+{
+	struct trial t = { s, 0, NULL, 0 };
+	memtrial_entry_t *e;
+	memcell_t *mc;
+	uintptr_t i;
+	bool queued = false;
+	DBGSTMT(char buf[21]);
+	DBGSTMT(char buf2[21]);
+
+	*freed = 0;
+	/* region cells go with the region, and the marker thread may be
+	   tracing any cell */
+	if(s->ms_flags.region
+#if defined(GC_CONCURRENT_MARK)
+	   || memstate_marker_busy(s)
+#endif /* defined(GC_CONCURRENT_MARK) */
+	   ) {
+		return false;
+	}
+	if(! s->trial_table) {
+		s->trial_table = s->mem_alloc(
+			2 * MEMORY_CYCLE_SCAN * sizeof(*(s->trial_table)),
+			s->mem_alloc_priv);
+		s->trial_order = s->mem_alloc(
+			2 * MEMORY_CYCLE_SCAN * sizeof(*(s->trial_order)),
+			s->mem_alloc_priv);
+		assert(s->trial_table && s->trial_order);
+		memset(s->trial_table, 0,
+		       2 * MEMORY_CYCLE_SCAN * sizeof(*(s->trial_table)));
+	}
+	t.stack = s->trial_order + MEMORY_CYCLE_SCAN;
+
+	/* a young candidate is only taken once promoted: collect the nursery
+	   first, which frees young garbage and promotes the rest */
+	for(i = 0; i < MEMORY_CYCLE_LOG_LEN; i++) {
+		mc = s->cycle_log[i];
+		if(mc && mc != CYCLE_LOG_FORGOTTEN && memcell_is_young(mc)) {
+			memory_gc_minor(s);
+			break;
+		}
+	}
+
+	/* take the candidates, then what they reach */
+	for(i = 0; i < MEMORY_CYCLE_LOG_LEN; i++) {
+		mc = s->cycle_log[i];
+		s->cycle_log[i] = NULL;
+		if(mc && mc != CYCLE_LOG_FORGOTTEN) {
+			memcell_meta_clear(mc, MC_CYCLE_CAND_BIT);
+			memstate_trial_take(&t, mc);
+		}
+	}
+	s->cycle_log_count = 0;
+	for(i = 0; i < t.len; i++) {
+		MEMSTATE_LINKS(s, dl_cb_trial_take, &(s->trial_order[i]->mc->data), &t);
+	}
+
+	/* a cell with more links than the other cells taken account for is
+	   linked from outside, and keeps alive what it links to */
+	for(i = 0; i < t.len; i++) {
+		MEMSTATE_LINKS(s, dl_cb_trial_count, &(s->trial_order[i]->mc->data), s);
+	}
+	for(i = 0; i < t.len; i++) {
+		e = s->trial_order[i];
+		if(memcell_refcount(e->mc) > e->internal) {
+			memstate_trial_live(&t, e);
+		}
+	}
+	while(t.depth) {
+		e = t.stack[--(t.depth)];
+		MEMSTATE_LINKS(s, dl_cb_trial_live, &(e->mc->data), &t);
+	}
+
+	/* the rest is garbage: drop its links, while all of it is still
+	   intact, then free it */
+	for(i = 0; i < t.len; i++) {
+		e = s->trial_order[i];
+		if(! e->live) {
+			MEMSTATE_LINKS(s, dl_cb_trial_unlink, &(e->mc->data), s);
+			if(MC_GET(e->mc->meta) & MC_QUEUED_BIT) {
+				queued = true;
+			}
+		}
+	}
+	if(queued) {
+		memstate_trial_unqueue(s);
+	}
+	for(i = 0; i < t.len; i++) {
+		e = s->trial_order[i];
+		if(! e->live) {
+#if defined(GC_REACHABILITY_VERIFICATION)
+			assert(!memcell_reachable(s, e->mc));
+#endif
+			memcell_free(s, e->mc);
+			(*freed)++;
+		}
+	}
+	for(i = 0; i < t.len; i++) {
+		s->trial_order[i]->mc = NULL;
+	}
+
+	s->trial_passes++;
+	s->trial_freed += *freed;
+	if(*freed) {
+		s->clean_cycles = 0;
+	}
+	DBGTRACELN(TC_GC_TRACING,
+	           "gc trial deletion: taken ", fmt_u64d(buf, t.len), " ",
+	           "freed=", fmt_u64d(buf2, *freed));
+	return true;
+}
+#endif /* defined(GC_CYCLE_COLLECT) */
+
+static bool memstate_step(memory_state_t *s)
+{
+	DBGSTMT(char buf[21]);
+	DBGSTMT(char buf2[21]);
+	DBGSTMT(char buf3[21]);
+	memcell_t *mc;
+	bool status = false;
+
+#if defined(GC_CONCURRENT_MARK)
+	if(s->mark_running) {
+		memstate_marker_refill(s);
+		memstate_marker_collect(s);
+	}
+#endif /* defined(GC_CONCURRENT_MARK) */
+
+	if(s->nursery_len && s->nursery_count >= s->nursery_len) {
+		memory_gc_minor(s);
+		goto finish;
+	}
+
+#if defined(GC_CYCLE_COLLECT)
+	if(s->cycle_log_count >= MEMORY_CYCLE_LOG_LEN / 4 * 3) {
+		uintptr_t freed;
+
+		if(memstate_trial_deletion(s, &freed)) {
+			goto finish;
+		}
+	}
+#endif /* defined(GC_CYCLE_COLLECT) */
+
+	/* 2 clean cycles allows unprocessed nodes to reach the free list */
+	if(s->clean_cycles == 2) {
+		s->skipped_clean_iters++;
+#if ! defined(NO_GC_FREELIST)
+		memslab_trim(s);
+#endif /* ! defined(NO_GC_FREELIST) */
+		/* although we didn't cycle, we return true because the last
+		   "full" cycle was clean */
+		status = true;
+		goto finish;
+	}
+
+#if ! defined(NO_GC_STATISTICS)
+	s->iter_count++;
+#endif
+	s->adapt_steps++;
+	if(! s->ms_flags.pacing) {
+		s->ms_flags.unpaced = true;
+	}
+
+	/* process free_pending nodes: move them to free_list. One still on the
+	   worklist waits at the back of the list until it has been popped. */
+	if(! mclist_is_empty(&(s->free_pending_list))) {
+		mc = (memcell_t *) mclist_first(&(s->free_pending_list));
+		if(MC_GET(mc->meta) & MC_QUEUED_BIT
+#if defined(GC_CONCURRENT_MARK)
+		   /* the marker may be tracing a marked cell: claim unmarked ones
+		      so it never will */
+		   || (memstate_marker_busy(s) && ! memcell_mark(s, mc))
+#endif /* defined(GC_CONCURRENT_MARK) */
+		   ) {
+			mclink_remove(&(mc->hdr));
+			mclist_insertlast(&(s->free_pending_list), &(mc->hdr));
+			goto boundary;
+		}
+#if defined(GC_REACHABILITY_VERIFICATION)
+		assert(!memcell_reachable(s, mc));
+#endif
+		DBGTRACE(TC_GC_TRACING,
+		         "gc (", fmt_u64d(buf, s->iter_count), ") ",
+		         "iter free_pending: ", fmt_ptr(buf2, mc), " ");
+		DBGRUN(TC_GC_TRACING, { s->p_cb(mc->data, dbgtrace_getstream()); });
+		assert(!memcell_locked(mc)); // locked nodes must stay in root list
+		/* TODO: what about loops here? should they still be unlinked? */
+		assert(!memcell_refcount(mc)); // free_pending nodees must be unlinked
+		MEMSTATE_LINKS(s, dl_cb_decref_free_pending_z, &(mc->data), s);
+		memcell_free(s, mc);
+#if ! defined(NO_GC_FREELIST)
+		DBGTRACELN(TC_MEM_ALLOC,
+		           "gc (", fmt_u64d(buf, s->iter_count), "): ",
+		           "free node (pending) ", fmt_ptr(buf2, mc), " ",
+		           "nfree=", fmt_u64d(buf3, s->total_free));
+		assert(s->total_free <= s->total_alloc);
+#endif /* ! defined(NO_GC_FREELIST) */
+		goto finish;
+	}
+
+boundary:
+#if defined(GC_CONCURRENT_MARK)
+	if(s->mark_running && s->worklist) {
+		memstate_marker_handoff(s);
+		goto finish;
+	}
+#endif /* defined(GC_CONCURRENT_MARK) */
+	/* process boundary nodes: trace their links. Cells that left the heap
+	   since they were queued (locked or unlinked) are skipped. */
+	if((mc = memstate_worklist_pop(s))) {
+		if(memcell_list(mc) != MC_LIST_HEAP) {
+			goto finish;
+		}
+		DBGTRACE(TC_GC_TRACING,
+		         "gc (", fmt_u64d(buf, s->iter_count), ") ",
+		         "iter reachable: ", fmt_ptr(buf2, mc), " ");
+		DBGRUN(TC_GC_TRACING, { s->p_cb(mc->data, dbgtrace_getstream()); });
+		assert(!memcell_locked(mc)); // locked nodes should stay in root list
+		assert(memcell_refcount(mc)); // referenced nodes should have refcount
+		MEMSTATE_LINKS(s, dl_cb_try_move_boundary, &(mc->data), s);
+		goto finish;
+	}
+
+	/* check to see if there are any root nodes to process: move their links
+	   to boundary */
+	if(mclist_first(&(s->roots_list)) != &(s->root_sentinel)) {
+		mc = (memcell_t *) mclist_first(&(s->roots_list));
+		DBGTRACE(TC_GC_TRACING,
+		         "gc (", fmt_u64d(buf, s->iter_count), ") ",
+		         "iter root: ", fmt_ptr(buf2, mc), " ");
+		DBGRUN(TC_GC_TRACING, { s->p_cb(mc->data, dbgtrace_getstream()); });
+		MEMSTATE_LINKS(s, dl_cb_try_move_boundary, &(mc->data), s);
+		/* after processing, rotate to end of list */
+		memcell_remove(s, mc);
+		memcell_to_roots_proc(s, mc);
+		goto finish;
+	}
+
+	if(! s->ms_flags.shadow_scanned) {
+		DBGTRACELN(TC_GC_TRACING,
+		           "gc (", fmt_u64d(buf, s->iter_count), ") ",
+		           "iter shadow roots: ", fmt_u64d(buf2, s->shadow_len));
+		memstate_shadow_scan(s);
+		goto finish;
+	}
+
+	/* young cells are not traced, so the old cells they link to may still be
+	   'unprocessed': promote the survivors once per cycle before sweeping */
+	if(! s->ms_flags.nursery_swept) {
+		s->ms_flags.nursery_swept = true;
+		if(! mclist_is_empty(&(s->nursery_list))) {
+			memory_gc_minor(s);
+			goto finish;
+		}
+	}
+
+#if defined(GC_CONCURRENT_MARK)
+	/* nothing is unreachable for sure until the marker is done, and the
+	   roots it found have been moved */
+	if(memstate_marker_busy(s)
+	   || __atomic_load_n(&(s->mark_returned), __ATOMIC_ACQUIRE)) {
+		goto finish;
+	}
+#endif /* defined(GC_CONCURRENT_MARK) */
+
+	/* remaining 'unprocessed' nodes are unreachable: 'free' them */
+	if(! memstate_sweep(s)) {
+		goto finish;
+	}
+	if(! mclist_is_empty(&(s->doomed_list))) {
+		memstate_doomed_free(s,
+		                     (memcell_t *) mclist_first(&(s->doomed_list)));
+		goto finish;
+	}
+
+	memstate_cycle_reset(s);
+	status = true;
+
+finish:
+	DBGRUN(TC_GC_VERBOSE, {  memory_gc_print_state(s, dbgtrace_getstream()); });
+	return status;
+}
+
+bool memory_gc_active(memory_state_t *s)
+{
+	return memstate_isactive(s);
+}
+
+bool memory_gc_iterate(memory_state_t *s)
+{
+	bool status;
+
+	assert(!memstate_isactive(s));
+	memstate_setactive(s);
+	/* GC steps rely on current refcounts */
+	memory_gc_rc_flush(s);
+	status = memstate_step(s);
+	memstate_resetactive(s);
+	return status;
+}
+
+static unsigned long long memstate_clock_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (unsigned long long) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+uintptr_t memory_gc_iterate_n(
+	memory_state_t *s,
+	uintptr_t n,
+	unsigned long long ns)
+{
+	unsigned long long deadline = 0;
+	uintptr_t steps = 0;
+
+	assert(!memstate_isactive(s));
+	memstate_setactive(s);
+	memory_gc_rc_flush(s);
+	if(ns) {
+		deadline = memstate_clock_ns() + ns;
+	}
+	while(! n || steps < n) {
+		steps++;
+		if(memstate_step(s) && s->clean_cycles == 2) {
+			break;
+		}
+		/* reading the clock costs about as much as a step */
+		if(ns && steps % MEMORY_SLICE_CLOCK_STEPS == 0
+		   && memstate_clock_ns() >= deadline) {
+			break;
+		}
+	}
+	memstate_resetactive(s);
+	return steps;
+}
+
+#if ! defined(NO_GC_FREELIST)
+/* heap cells found by compaction, still to be copied */
+struct compact_walk
+{
+	memory_state_t *s;
+	memcell_t **stack;
+	uintptr_t len, cap;
+};
+
+static void compact_walk_push(struct compact_walk *w, memcell_t *mc)
+{
+	memcell_t **stack;
+	uintptr_t i;
+
+	if(w->len == w->cap) {
+		w->cap = w->cap ? w->cap * 2 : 64;
+		stack = w->s->mem_alloc(w->cap * sizeof(*stack), w->s->mem_alloc_priv);
+		assert(stack);
+		for(i = 0; i < w->len; i++) {
+			stack[i] = w->stack[i];
+		}
+		if(w->stack) {
+			w->s->mem_free(w->stack, w->s->mem_alloc_priv);
+		}
+		w->stack = stack;
+	}
+	w->stack[w->len++] = mc;
+}
+
+/* links are only fixed up once everything is copied, so every link still
+   points to an original: a heap cell is one not copied yet */
+static void dl_cb_compact_push(void *link, void *p)
+{
+	if(link && memcell_list(data_to_memcell(link)) == MC_LIST_HEAP) {
+		compact_walk_push((struct compact_walk *) p, data_to_memcell(link));
+	}
+}
+
+/* copy mc to the slab its class is carving, and leave the address of the
+   copy's data behind in mc */
+static memcell_t *memcell_compact_copy(memory_state_t *s, memcell_t *mc)
+{
+	memslab_t *slab = memcell_slab(mc);
+	memcell_t *copy = memslab_carve(s, &(s->classes[slab->cls]), slab->cls);
+	void *fwd = copy->data;
+
+	memcpy(copy->data, mc->data, slab->cell_len - sizeof(memcell_t));
+	mclist_init(&(copy->hdr));
+	MC_SET(copy->rc_flags, MC_GET(mc->rc_flags));
+	/* the original stays logged as a cycle candidate until it is freed */
+	MC_SET(copy->meta,
+	       (MC_GET(copy->meta) & ~(uint32_t) ((1 << MC_OFF_SHIFT) - 1))
+	       | (MC_GET(mc->meta) & ((1 << MC_OFF_SHIFT) - 1)
+	          & ~(uint32_t) MC_CYCLE_CAND_BIT));
+	if(memcell_fin_index(copy)) {
+		memcell_slab(copy)->nfin++;
+	}
+#if ! defined(NO_GC_STATISTICS)
+	s->total_alloc++;
+#endif /* ! defined(NO_GC_STATISTICS) */
+	memcell_set_list(mc, MC_LIST_MOVED);
+	/* memcpy(), as the data is not a void * to the compiler */
+	memcpy(mc->data, &fwd, sizeof(fwd));
+	return copy;
+}
+
+/* copy the heap cells found by the walk so far, and those they link to */
+static uintptr_t memstate_compact_walk(struct compact_walk *w)
+{
+	memcell_t *mc;
+	uintptr_t moved = 0;
+
+	while(w->len) {
+		mc = w->stack[--w->len];
+		if(memcell_list(mc) != MC_LIST_HEAP) {
+			continue;
+		}
+		mc = memcell_compact_copy(w->s, mc);
+		moved++;
+		MEMSTATE_LINKS(w->s, dl_cb_compact_push, &(mc->data), w);
+	}
+	return moved;
+}
+
+static void *compact_fix(void *link, void *p)
+{
+	memcell_t *mc;
+	void *fwd;
+
+	(void) p;
+	if(! link) {
+		return NULL;
+	}
+	mc = data_to_memcell(link);
+	if(memcell_list(mc) == MC_LIST_MOVED) {
+		memcpy(&fwd, mc->data, sizeof(fwd));
+		return fwd;
+	}
+	return link;
+}
+#endif /* ! defined(NO_GC_FREELIST) */
+
+uintptr_t memory_gc_compact(memory_state_t *s)
+{
+#if ! defined(NO_GC_FREELIST)
+	struct compact_walk w = { s, NULL, 0, 0 };
+	mclink_t *cursor;
+	dlnode_t *slab_cursor, *next;
+	memslab_t *slab;
+	memcell_t *mc;
+	uintptr_t i, moved = 0;
+	unsigned int cls;
+	bool oom = s->ms_flags.oom;
+	DBGSTMT(char buf[21]);
+	DBGSTMT(char buf2[21]);
+
+	if(! s->r_cb || s->ms_flags.region) {
+		return 0;
+	}
+
+	/* copy only what survives a full cycle, starting at a cycle boundary
+	   where no cell is queued or doomed */
+	memory_gc_minor(s);
+	memory_gc_cycle(s);
+#if defined(GC_CONCURRENT_MARK)
+	if(s->mark_running) {
+		memstate_marker_sync(s);
+	}
+#endif /* defined(GC_CONCURRENT_MARK) */
+	if(s->worklist || s->ms_flags.sweeping) {
+		return 0;
+	}
+
+	/* copies go to fresh slabs */
+	for(cls = 0; cls < MEMORY_SIZE_CLASSES; cls++) {
+		s->classes[cls].slab_cur = NULL;
+	}
+	MCLIST_FOR_FWD(&(s->roots_list), cursor) {
+		if(cursor == &(s->root_sentinel)) {
+			continue;
+		}
+		MEMSTATE_LINKS(s, dl_cb_compact_push, &(((memcell_t *) cursor)->data), &w);
+		moved += memstate_compact_walk(&w);
+	}
+	for(i = 0; i < s->shadow_len; i++) {
+		dl_cb_compact_push(*(s->shadow[i]), &w);
+		moved += memstate_compact_walk(&w);
+	}
+	if(w.stack) {
+		s->mem_free(w.stack, s->mem_alloc_priv);
+	}
+
+	/* every live cell that stayed, copies included, may link to originals */
+	DLIST_FOR_FWD(&(s->slab_list), slab_cursor) {
+		slab = (memslab_t *) slab_cursor;
+		for(i = 0; i < slab->ncells; i++) {
+			mc = memslab_cell(slab, i);
+			if(memcell_live(mc)
+			   && memcell_list(mc) != MC_LIST_MOVED
+			   && memcell_list(mc) != MC_LIST_FINALIZE) {
+				s->r_cb(compact_fix, &(mc->data), s);
+			}
+		}
+	}
+	for(i = 0; i < s->shadow_len; i++) {
+		*(s->shadow[i]) = compact_fix(*(s->shadow[i]), s);
+	}
+	/* weak links are kept by cell, the cells of the copies now */
+	if(s->weak_count) {
+		memstate_weak_rehash(s, s->weak_len, compact_fix);
+	}
+
+	/* the originals are freed without their finalizers or weak links, which
+	   the copies carry on */
+	DLIST_FOR_FWD(&(s->slab_list), slab_cursor) {
+		slab = (memslab_t *) slab_cursor;
+		for(i = 0; i < slab->ncells; i++) {
+			mc = memslab_cell(slab, i);
+			if(memcell_list(mc) == MC_LIST_MOVED) {
+				memcell_set_fin_index(mc, 0);
+				memcell_meta_clear(mc, MC_WEAK_TARGET_BIT | MC_WEAK_HOLDER_BIT);
+				memcell_free(s, mc);
+			}
+		}
+	}
+
+	for(slab_cursor = dlist_first(&(s->slab_list));
+	    ! dlnode_is_terminal(slab_cursor) && s->slab_empty > s->trim_low;
+	    slab_cursor = next) {
+		next = dlnode_next(slab_cursor);
+		slab = (memslab_t *) slab_cursor;
+		if(slab->nfree == slab->ncells) {
+			memslab_release(s, slab);
+		}
+	}
+
+	/* the heap only grew for the copies */
+	if(! oom && (! s->hard_limit || s->heap_len <= s->hard_limit)) {
+		s->ms_flags.oom = false;
+	}
+	s->compacted_cells += moved;
+	DBGTRACELN(TC_GC_TRACING,
+	           "gc compact: moved ", fmt_u64d(buf, moved), " ",
+	           "nslabs=", fmt_u64d(buf2, s->slab_count));
+	return moved;
+#else /* defined(NO_GC_FREELIST) */
+	(void) s;
+	return 0;
+#endif /* ! defined(NO_GC_FREELIST) */
+}
+
+unsigned int memory_gc_fragmentation(memory_state_t *s)
+{
+#if ! defined(NO_GC_FREELIST)
+	dlnode_t *cursor;
+	memslab_t *slab;
+	uintptr_t carved = 0, nfree = 0;
+
+	/* empty slabs are spare, not fragmented */
+	DLIST_FOR_FWD(&(s->slab_list), cursor) {
+		slab = (memslab_t *) cursor;
+		if(slab->nfree != slab->ncells) {
+			carved += slab->ncells;
+			nfree += slab->nfree;
+		}
+	}
+	return carved ? nfree * 100 / carved : 0;
+#else /* defined(NO_GC_FREELIST) */
+	(void) s;
+	return 0;
+#endif /* ! defined(NO_GC_FREELIST) */
+}
+
+void memory_gc_defer_finalizers(memory_state_t *s, bool defer)
+{
+	s->ms_flags.defer_fin = defer;
+	if(! defer) {
+		memory_gc_run_finalizers(s, 0);
+	}
+}
+
+uintptr_t memory_gc_run_finalizers(memory_state_t *s, uintptr_t n)
+{
+	memcell_t *mc;
+	uintptr_t ran = 0;
 
-	memcell_t *mc = data_to_memcell(data);
-	memcell_lock(mc);
-	if(! memcell_is_root(s, mc)) {
-		DBGTRACE(TC_GC_TRACING, "gc: add root ", fmt_ptr(buf, mc), " ");
-		DBGRUN(TC_GC_TRACING, { s->p_cb(mc->data, dbgtrace_getstream()); });
-		dlnode_remove(&(mc->hdr));
-		memcell_to_roots_unproc(s, mc);
+	while((! n || ran < n) && ! mclist_is_empty(&(s->finalize_list))) {
+		mc = (memcell_t *) mclist_first(&(s->finalize_list));
+		s->finalize_len--;
+		memcell_free(s, mc);
+		ran++;
+	}
+	s->finalized_count += ran;
+	return ran;
+}
+
+void memory_gc_weak_link(memory_state_t *s, void *holder, void *target)
+{
+	memcell_t *mc;
+
+	assert(s->r_cb);
+	if(! target) {
+		return;
+	}
+	if(! s->weak_len) {
+		memstate_weak_rehash(s, MEMORY_WEAK_MIN_LEN, NULL);
+	} else if(s->weak_count + 1 > s->weak_len / 2) {
+		memstate_weak_rehash(s, s->weak_len * 2, NULL);
+	}
+	mc = data_to_memcell(target);
+	memstate_weak_insert(s, data_to_memcell(holder), mc);
+	memcell_meta_set(mc, MC_WEAK_TARGET_BIT);
+	memcell_meta_set(data_to_memcell(holder), MC_WEAK_HOLDER_BIT);
+}
+
+void memory_gc_weak_unlink(memory_state_t *s, void *holder, void *target)
+{
+	memweak_entry_t *e;
+
+	if(! target) {
+		return;
+	}
+	e = memstate_weak_find(s, data_to_memcell(holder), data_to_memcell(target));
+	assert(e);
+	memstate_weak_delete(s, e);
+}
+
+void *memory_gc_weak_get(memory_state_t *s, void *target)
+{
+	memcell_t *mc;
+
+	if(! target) {
+		return NULL;
+	}
+	mc = data_to_memcell(target);
+	if(memcell_is_doomed(s, mc)
+	   || memcell_list(mc) == MC_LIST_FREE_PENDING) {
+		return NULL;
+	}
+	return target;
+}
+
+#if defined(GC_PARALLEL_CYCLE)
+/* memory_gc_cycle_parallel() runs in phases: the workers mark from stacks of
+   worklist chunks of their own, putting every full chunk where any worker
+   can take it, then sweep the slabs in two passes, first dropping the links
+   of the unreachable cells and then freeing them. The calling thread
+   coordinates and is the only one to use the state's allocator, handing
+   out spare chunks while the workers run. */
+enum gc_phase
+{
+	GC_PHASE_MARK,
+	GC_PHASE_UNLINK,
+	GC_PHASE_FREE,
+	GC_PHASE_EXIT
+};
+
+struct gc_par;
+
+struct gc_worker
+{
+	struct gc_par *par;
+	unsigned int id;
+	pthread_t thread;
+	pthread_mutex_t lock; /* guards shared and nshared */
+	memchunk_t *shared; /* full chunks to trace, any worker may take one */
+	uintptr_t nshared;
+	memchunk_t *stack; /* the chunk being traced */
+	memchunk_t *spare;
+	/* cells left to the calling thread after the phase: unlocked roots
+	   found linked, cells whose refcount dropped to zero, or unreachable
+	   cells with a finalizer */
+	memchunk_t *found;
+	unsigned long long traced, unlinked, freed;
+	uintptr_t emptied; /* slabs with every carved cell free */
+	mclink_t free_lists[2 * MEMORY_SIZE_CLASSES]; /* region classes last */
+};
+
+struct gc_par
+{
+	memory_state_t *s;
+	struct gc_worker *workers;
+	unsigned int n;
+	pthread_mutex_t lock; /* guards all but idle and next_slab */
+	pthread_cond_t cond;
+	enum gc_phase phase;
+	unsigned long long seq; /* bumped when a phase starts */
+	unsigned int running; /* workers not done with the phase */
+	unsigned int idle; /* marking workers out of work */
+	memchunk_t *pool;
+	bool need_chunks;
+	memslab_t **slabs;
+	uintptr_t nslabs, next_slab;
+};
+
+static memchunk_t *gc_par_chunk(struct gc_worker *w, memchunk_t *next)
+{
+	struct gc_par *par = w->par;
+	memchunk_t *chunk = w->spare;
+
+	if(chunk) {
+		w->spare = NULL;
 	} else {
-		DBGTRACE(TC_GC_TRACING, "gc: add root ", fmt_ptr(buf, mc), " (noop) ");
-		DBGRUN(TC_GC_TRACING, { s->p_cb(mc->data, dbgtrace_getstream()); });
+		pthread_mutex_lock(&(par->lock));
+		while(! par->pool) {
+			par->need_chunks = true;
+			pthread_cond_broadcast(&(par->cond));
+			pthread_cond_wait(&(par->cond), &(par->lock));
+		}
+		chunk = par->pool;
+		par->pool = chunk->next;
+		pthread_mutex_unlock(&(par->lock));
 	}
+	chunk->next = next;
+	chunk->len = 0;
+	return chunk;
 }
 
-void memory_gc_unlock(memory_state_t *s, void *data)
+static void gc_par_found(struct gc_worker *w, memcell_t *mc)
 {
-	/* clear lock, make boundary if referenced, else make free_pending */
-	DBGSTMT(char buf[21];);
+	if(! w->found || w->found->len == MEMORY_WORKLIST_CHUNK) {
+		w->found = gc_par_chunk(w, w->found);
+	}
+	w->found->cells[w->found->len++] = mc;
+}
 
-	memcell_t *mc = data_to_memcell(data);
-	assert(memcell_is_root(s, mc));
+static void gc_par_share(struct gc_worker *w, memchunk_t *chunk)
+{
+	pthread_mutex_lock(&(w->lock));
+	chunk->next = w->shared;
+	w->shared = chunk;
+	__atomic_store_n(&(w->nshared), w->nshared + 1, __ATOMIC_SEQ_CST);
+	pthread_mutex_unlock(&(w->lock));
+}
 
-	DBGTRACE(TC_GC_TRACING, "gc: rem root ", fmt_ptr(buf, mc), " ");
-	DBGRUN(TC_GC_TRACING, { s->p_cb(mc->data, dbgtrace_getstream()); });
+static void gc_par_push(struct gc_worker *w, memcell_t *mc)
+{
+	if(w->stack->len == MEMORY_WORKLIST_CHUNK) {
+		gc_par_share(w, w->stack);
+		w->stack = gc_par_chunk(w, NULL);
+	}
+	w->stack->cells[w->stack->len++] = mc;
+}
 
-	dlnode_remove(&(mc->hdr));
-	if(memcell_refcount(mc)) {
-		memcell_to_boundary(s, mc);
+/* take a shared chunk to trace, from this worker first */
+static bool gc_par_take(struct gc_worker *w)
+{
+	struct gc_par *par = w->par;
+	struct gc_worker *v;
+	memchunk_t *chunk = NULL;
+	unsigned int i;
+
+	for(i = 0; i < par->n && ! chunk; i++) {
+		v = &(par->workers[(w->id + i) % par->n]);
+		if(! __atomic_load_n(&(v->nshared), __ATOMIC_SEQ_CST)) {
+			continue;
+		}
+		pthread_mutex_lock(&(v->lock));
+		if((chunk = v->shared)) {
+			v->shared = chunk->next;
+			__atomic_store_n(&(v->nshared), v->nshared - 1, __ATOMIC_SEQ_CST);
+		}
+		pthread_mutex_unlock(&(v->lock));
+	}
+	if(! chunk) {
+		return false;
+	}
+	/* the stack is empty when this is called */
+	if(w->spare) {
+		pthread_mutex_lock(&(par->lock));
+		w->stack->next = par->pool;
+		par->pool = w->stack;
+		pthread_mutex_unlock(&(par->lock));
 	} else {
-		memcell_to_free_pending(s, mc);
+		w->spare = w->stack;
 	}
-	memcell_unlock(mc);
-	s->clean_cycles = 0; // may need to begin cleanup
+	chunk->next = NULL;
+	w->stack = chunk;
+	return true;
 }
 
-void memory_gc_advise_new_link(memory_state_t *s, void *data)
+static bool gc_par_any_shared(struct gc_par *par)
 {
-	/* increase refcount, move to 'boundary' if 'unprocessed' */
+	unsigned int i;
+
+	for(i = 0; i < par->n; i++) {
+		if(__atomic_load_n(&(par->workers[i].nshared), __ATOMIC_SEQ_CST)) {
+			return true;
+		}
+	}
+	return false;
+}
 
+/* like dl_cb_marker_trace(), but the world is stopped */
+static void dl_cb_par_trace(void *link, void *p)
+{
+	struct gc_worker *w = (struct gc_worker *) p;
 	memcell_t *mc;
-	DBGSTMT(char buf[21]);
-	DBGSTMT(char buf2[21]);
-	DBGSTMT(char buf3[21]);
 
-	(void) s;
-	if(!data) {
+	if(! link) {
 		return;
 	}
-	mc = data_to_memcell(data);
-	memcell_incref(mc);
-	DBGTRACELN(TC_MEM_RC,
-	           "gc: ", fmt_ptr(buf, mc), " ",
-	           "(", fmt_ptr(buf2, mc->data), ") ",
-	           "refcount++ -> ", fmt_u64d(buf3, memcell_refcount(mc)));
-	assert(! memcell_is_free(s, mc));
-	assert(! memcell_is_free_pending(s, mc));
-	/* pull this node out of the unprocessed list if applicable.
-	   'boundaries' and 'reachables' are self-evidently unnecessary
-	   'roots' will be taken care of eventually during GC iteration
-	   if we don't do this, we may lose an 'unprocessed' node if:
-	   - it is being linked to by a root node that has already been 'processed'
-	   - and it is being unlnked from a nonroot that is not 'processed' */
-	if(memcell_is_unproc(s, mc)) {
-		dlnode_remove(&(mc->hdr));
-		memcell_to_boundary(s, mc);
+	mc = data_to_memcell(link);
+	switch(__atomic_load_n(&(mc->meta), __ATOMIC_RELAXED) & MC_LIST_MASK) {
+	case MC_LIST_HEAP:
+		if(memcell_mark_shared(w->par->s, mc)) {
+			gc_par_push(w, mc);
+		}
+		break;
+	case MC_LIST_ROOT:
+		if(! memcell_locked(mc)) {
+			gc_par_found(w, mc);
+		}
+		break;
+	default:
+		break;
 	}
 }
 
-void memory_gc_advise_stale_link(memory_state_t *s, void *data)
+/* trace until every worker is out of work */
+static void gc_par_mark(struct gc_worker *w)
 {
+	struct gc_par *par = w->par;
+	memory_state_t *s = par->s;
 	memcell_t *mc;
-	DBGSTMT(char buf[21]);
-	DBGSTMT(char buf2[21]);
-	DBGSTMT(char buf3[21]);
 
-	/* decrease refcount, move to free_pending unreferenced and not locked */
+	w->stack = gc_par_chunk(w, NULL);
+	for(;;) {
+		while(w->stack->len) {
+			mc = w->stack->cells[--(w->stack->len)];
+			MEMSTATE_LINKS(s, dl_cb_par_trace, &(mc->data), w);
+			w->traced++;
+		}
+		if(gc_par_take(w)) {
+			continue;
+		}
+		/* a worker only goes idle once it found nothing to take, and only
+		   busy workers share chunks: once all are idle nothing is left */
+		__atomic_add_fetch(&(par->idle), 1, __ATOMIC_SEQ_CST);
+		for(;;) {
+			if(__atomic_load_n(&(par->idle), __ATOMIC_SEQ_CST) == par->n) {
+				return;
+			}
+			if(gc_par_any_shared(par)) {
+				__atomic_sub_fetch(&(par->idle), 1, __ATOMIC_SEQ_CST);
+				if(gc_par_take(w)) {
+					break;
+				}
+				__atomic_add_fetch(&(par->idle), 1, __ATOMIC_SEQ_CST);
+			}
+			sched_yield();
+		}
+	}
+}
 
-	if(!data) {
+/* the world is stopped, so an unreachable cell is one left unmarked */
+static bool gc_par_unreachable(memory_state_t *s, memcell_t *mc)
+{
+	return memcell_list(mc) == MC_LIST_HEAP && ! memcell_marked(s, mc);
+}
+
+static void dl_cb_par_unlink(void *link, void *p)
+{
+	struct gc_worker *w = (struct gc_worker *) p;
+	memcell_t *mc;
+
+	if(! link) {
 		return;
 	}
-	s->clean_cycles = 0; // may need to begin cleanup
-	mc = data_to_memcell(data);
-	if(! memcell_refcount(mc)) { // may already be zero if there is a loop
-		DBGTRACELN(TC_MEM_RC,
-		           "gc: ", fmt_ptr(buf, mc), " ",
-		           "(", fmt_ptr(buf2, mc->data), ") ",
-		           "refcount-- 0 -> 0 (loop?)");
-		/* unreferenced nodes shouldn't be live */
-		assert(memcell_is_free_pending(s, mc) ||
-		       memcell_is_free(s, mc));
+	mc = data_to_memcell(link);
+	if(gc_par_unreachable(w->par->s, mc)) {
 		return;
 	}
-	memcell_decref(mc);
-	DBGTRACELN(TC_MEM_RC,
-	           "gc: ", fmt_ptr(buf, mc), " ",
-	           "(", fmt_ptr(buf2, mc->data), ") ",
-	           "refcount-- -> ", fmt_u64d(buf3, memcell_refcount(mc)));
-	if(! memcell_refcount(mc)
-	   && ! memcell_locked(mc)
-	   && ! memcell_is_free(s, mc) /* if loop node may already be in free */) {
-		dlnode_remove(&(mc->hdr));
-		memcell_to_free_pending(s, mc);
+	w->unlinked++;
+	assert(memcell_refcount(mc));
+	/* nobody moves a saturated count, so the check cannot go stale */
+	if((__atomic_load_n(&(mc->rc_flags), __ATOMIC_RELAXED) >> MC_RC_SHIFT)
+	   == MC_RC_MAX) {
+		return;
+	}
+	if(! (__atomic_sub_fetch(&(mc->rc_flags), MC_RC_ONE, __ATOMIC_RELAXED)
+	      >> MC_RC_SHIFT)) {
+		gc_par_found(w, mc);
 	}
 }
 
-bool memory_gc_isroot(memory_state_t *s, void *data)
+static void gc_par_free(struct gc_worker *w, memslab_t *slab, memcell_t *mc)
 {
-	bool status;
-	memcell_t *mc;
-	if(!data) {
-		return false;
+	unsigned int i = slab->cls + (slab->region ? MEMORY_SIZE_CLASSES : 0);
+
+	/* finalizers and weak links are left to the calling thread */
+	if(memcell_fin_index(mc)
+	   || (MC_GET(mc->meta) & (MC_WEAK_TARGET_BIT | MC_WEAK_HOLDER_BIT
+	                   | MC_CYCLE_CAND_BIT))) {
+		gc_par_found(w, mc);
+		return;
 	}
-	mc = data_to_memcell(data);
-	status = memcell_is_root(s, mc);
-	return status;
+	memcell_flags_clear(mc, MC_FLAG_LIVE);
+	mclist_insertlast(&(w->free_lists[i]), &(mc->hdr));
+	memcell_set_list(mc, MC_LIST_FREE);
+	if(++(slab->nfree) == slab->ncells) {
+		w->emptied++;
+	}
+	w->freed++;
 }
 
-bool memory_gc_islive(memory_state_t *s, void *data)
+/* each slab is swept by one worker */
+static void gc_par_sweep(struct gc_worker *w, enum gc_phase phase)
 {
+	struct gc_par *par = w->par;
+	memory_state_t *s = par->s;
+	memslab_t *slab;
 	memcell_t *mc;
-	if(!data) {
-		return false;
+	uintptr_t i, j;
+
+	while((j = __atomic_fetch_add(&(par->next_slab), 1, __ATOMIC_RELAXED))
+	      < par->nslabs) {
+		slab = par->slabs[j];
+		for(i = 0; i < slab->ncells; i++) {
+			mc = memslab_cell(slab, i);
+			if(! gc_par_unreachable(s, mc)) {
+				continue;
+			}
+			if(phase == GC_PHASE_UNLINK) {
+				MEMSTATE_LINKS(s, dl_cb_par_unlink, &(mc->data), w);
+			} else {
+				gc_par_free(w, slab, mc);
+			}
+		}
 	}
-	mc = data_to_memcell(data);
-	return !memcell_is_free(s, mc);
 }
 
-static void dl_cb_try_move_boundary(void *link, void *p)
+static void *gc_par_main(void *p)
 {
-	/* move to boundary if unprocessed, or an unlocked root */
-	DBGSTMT(char buf[21];)
+	struct gc_worker *w = (struct gc_worker *) p;
+	struct gc_par *par = w->par;
+	unsigned long long seq = 0;
+	enum gc_phase phase;
 
-	memory_state_t *s = (memory_state_t *) p;
-	memcell_t *mc;
+	pthread_mutex_lock(&(par->lock));
+	for(;;) {
+		while(par->seq == seq) {
+			pthread_cond_wait(&(par->cond), &(par->lock));
+		}
+		seq = par->seq;
+		phase = par->phase;
+		pthread_mutex_unlock(&(par->lock));
+		if(phase == GC_PHASE_EXIT) {
+			break;
+		}
 
-	if(!link) {
-		DBGTRACELN(TC_GC_TRACING,"gc: move boundary null (noop)");
-		return;
+		if(phase == GC_PHASE_MARK) {
+			gc_par_mark(w);
+		} else {
+			gc_par_sweep(w, phase);
+		}
+
+		pthread_mutex_lock(&(par->lock));
+		if(! --(par->running)) {
+			pthread_cond_broadcast(&(par->cond));
+		}
 	}
-	mc = data_to_memcell(link);
+	return NULL;
+}
 
-	/* linked data should never be in the free or free_pending list */
-	assert(! memcell_is_free(s, mc));
-	assert(! memcell_is_free_pending(s, mc));
-	/* linked data should be referenced */
-	assert(memcell_refcount(mc));
+static void gc_par_pool_add(struct gc_par *par, memchunk_t *chunk)
+{
+	chunk->next = par->pool;
+	par->pool = chunk;
+}
 
-	if(memcell_is_unproc(s, mc)){
-		DBGTRACE(TC_GC_TRACING,
-		         "gc: move boundary unproc ", fmt_ptr(buf, mc), " ");
-		DBGRUN(TC_GC_TRACING, { s->p_cb(mc->data, dbgtrace_getstream()); });
-		dlnode_remove(&(mc->hdr));
-		memcell_to_boundary(s, mc);
-	} else if(memcell_is_root(s, mc)) {
-		DBGTRACE(TC_GC_TRACING,
-		         "gc: move boundary root ", fmt_ptr(buf, mc), 
-		         (memcell_locked(mc) ? " (L)" : " "));
-		DBGRUN(TC_GC_TRACING, { s->p_cb(mc->data, dbgtrace_getstream()); });
-		if(! memcell_locked(mc)) {
-			dlnode_remove(&(mc->hdr));
-			memcell_to_boundary(s, mc);
+/* run a phase on every worker, allocating chunks for them meanwhile */
+static void gc_par_run(struct gc_par *par, enum gc_phase phase)
+{
+	memory_state_t *s = par->s;
+	memchunk_t *chunk;
+	unsigned int i;
+
+	pthread_mutex_lock(&(par->lock));
+	par->phase = phase;
+	par->seq++;
+	par->running = par->n;
+	pthread_cond_broadcast(&(par->cond));
+	while(par->running) {
+		if(! par->need_chunks) {
+			pthread_cond_wait(&(par->cond), &(par->lock));
+			continue;
 		}
-	} else {
-		DBGTRACE(TC_GC_TRACING,
-		         "gc: move boundary noop ", fmt_ptr(buf, mc), " ");
-		DBGRUN(TC_GC_TRACING, { s->p_cb(mc->data, dbgtrace_getstream()); });
+		pthread_mutex_unlock(&(par->lock));
+		for(i = 0; i < par->n; i++) {
+			chunk = s->mem_alloc(sizeof(*chunk), s->mem_alloc_priv);
+			assert(chunk);
+			pthread_mutex_lock(&(par->lock));
+			gc_par_pool_add(par, chunk);
+			pthread_mutex_unlock(&(par->lock));
+		}
+		pthread_mutex_lock(&(par->lock));
+		par->need_chunks = false;
+		pthread_cond_broadcast(&(par->cond));
 	}
+	pthread_mutex_unlock(&(par->lock));
 }
 
-static void dl_cb_decref_free_pending_z(void *link, void *p)
+/* hand the cells of chunk to the workers as mark stacks of their own */
+static void gc_par_seed(struct gc_par *par, memchunk_t *chunk, unsigned int *i)
 {
-	memory_state_t *s = (memory_state_t *) p;
-	memory_gc_advise_stale_link(s, link);
+	gc_par_share(&(par->workers[*i % par->n]), chunk);
+	(*i)++;
 }
 
-/* returns true when a complete gc cycle has been completed */
-bool memory_gc_iterate(memory_state_t *s)
+static void gc_par_seed_cell(
+	struct gc_par *par,
+	memchunk_t **chunk,
+	unsigned int *i,
+	memcell_t *mc)
+{
+	memory_state_t *s = par->s;
+
+	if(! *chunk) {
+		if(! (*chunk = par->pool)) {
+			*chunk = s->mem_alloc(sizeof(**chunk), s->mem_alloc_priv);
+			assert(*chunk);
+		} else {
+			par->pool = (*chunk)->next;
+		}
+		(*chunk)->len = 0;
+	}
+	(*chunk)->cells[(*chunk)->len++] = mc;
+	if((*chunk)->len == MEMORY_WORKLIST_CHUNK) {
+		gc_par_seed(par, *chunk, i);
+		*chunk = NULL;
+	}
+}
+
+/* returns false if not a single worker thread could be started */
+static bool memstate_cycle_parallel(memory_state_t *s, unsigned int nthreads)
 {
+	struct gc_par par;
+	struct gc_worker *w;
+	memchunk_t *chunk, *next;
+	memcell_t *mc;
+	mclink_t *cursor;
+	dlnode_t *slab_cursor;
+	memslab_t *slab;
+	unsigned int i, j, seeded = 0;
+	uintptr_t k;
+	bool unlinked = false;
 	DBGSTMT(char buf[21]);
 	DBGSTMT(char buf2[21]);
-	DBGSTMT(char buf3[21]);
-	memcell_t *mc;
-	bool status = false;
 
-	assert(!memstate_isactive(s));
-#if !defined(NDEBUG) /* this is useless without the assert above */
-	memstate_setactive(s);
-#endif
-	/* 2 clean cycles allows unprocessed nodes to reach the free list */
-	if(s->clean_cycles == 2) {
-		s->skipped_clean_iters++;
-		/* although we didn't cycle, we return true because the last
-		   "full" cycle was clean */
-		status = true;
-		goto finish;
+	par.s = s;
+	par.n = 0;
+	par.phase = GC_PHASE_MARK;
+	par.seq = 0;
+	par.running = 0;
+	par.idle = 0;
+	par.pool = NULL;
+	par.need_chunks = false;
+	par.slabs = NULL;
+	par.nslabs = par.next_slab = 0;
+	pthread_mutex_init(&(par.lock), NULL);
+	pthread_cond_init(&(par.cond), NULL);
+	par.workers = s->mem_alloc(nthreads * sizeof(*w), s->mem_alloc_priv);
+	assert(par.workers);
+	for(i = 0; i < nthreads; i++) {
+		w = &(par.workers[i]);
+		w->par = &par;
+		w->id = i;
+		pthread_mutex_init(&(w->lock), NULL);
+		w->shared = w->stack = w->spare = w->found = NULL;
+		w->nshared = 0;
+		w->traced = w->unlinked = w->freed = 0;
+		w->emptied = 0;
+		for(j = 0; j < 2 * MEMORY_SIZE_CLASSES; j++) {
+			mclist_init(&(w->free_lists[j]));
+		}
+		if(pthread_create(&(w->thread), NULL, gc_par_main, w)) {
+			pthread_mutex_destroy(&(w->lock));
+			break;
+		}
+		par.n++;
+	}
+	if(! par.n) {
+		goto cleanup;
+	}
+	for(i = 0; i < 2 * par.n; i++) {
+		chunk = s->mem_alloc(sizeof(*chunk), s->mem_alloc_priv);
+		assert(chunk);
+		gc_par_pool_add(&par, chunk);
 	}
 
-#if ! defined(NO_GC_STATISTICS)
-	s->iter_count++;
-#endif
+	/* a cycle sweeping with marks of its own is finished as usual */
+	while(s->ms_flags.sweeping) {
+		memstate_step(s);
+	}
+#if defined(GC_CONCURRENT_MARK)
+	if(s->mark_running) {
+		memstate_marker_sync(s);
+		memstate_marker_collect(s);
+	}
+#endif /* defined(GC_CONCURRENT_MARK) */
+	if(! mclist_is_empty(&(s->nursery_list))) {
+		memory_gc_minor(s);
+	}
 
-	/* process free_pending nodes: move them to free_list */
-	if(! dlist_is_empty(&(s->free_pending_list))) {
-		mc = (memcell_t *) dlist_first(&(s->free_pending_list));
-#if defined(GC_REACHABILITY_VERIFICATION)
-		assert(!memcell_reachable(s, mc));
-#endif
-		DBGTRACE(TC_GC_TRACING,
-		         "gc (", fmt_u64d(buf, s->iter_count), ") ",
-		         "iter free_pending: ", fmt_ptr(buf2, mc), " ");
-		DBGRUN(TC_GC_TRACING, { s->p_cb(mc->data, dbgtrace_getstream()); });
-		assert(!memcell_locked(mc)); // locked nodes must stay in root list
-		/* TODO: what about loops here? should they still be unlinked? */
-		assert(!memcell_refcount(mc)); // free_pending nodees must be unlinked
-		s->dl_cb(dl_cb_decref_free_pending_z, &(mc->data), s);
-		memcell_free(s, mc);
-#if ! defined(NO_GC_FREELIST)
-		DBGTRACELN(TC_MEM_ALLOC,
-		           "gc (", fmt_u64d(buf, s->iter_count), "): ",
-		           "free node (pending) ", fmt_ptr(buf2, mc), " ",
-		           "nfree=", fmt_u64d(buf3, s->total_free));
-		assert(s->total_free <= s->total_alloc);
-#endif /* ! defined(NO_GC_FREELIST) */
-		goto finish;
+	/* the workers start from every root and from the boundary so far, the
+	   marks already made this cycle stand. The root slots join the
+	   boundary. */
+	memstate_shadow_scan(s);
+	chunk = NULL;
+	MCLIST_FOR_FWD(&(s->roots_list), cursor) {
+		if(cursor != &(s->root_sentinel)) {
+			gc_par_seed_cell(&par, &chunk, &seeded, (memcell_t *) cursor);
+		}
+	}
+	while(s->worklist) {
+		next = s->worklist->next;
+		for(k = 0; k < s->worklist->len; k++) {
+			mc = s->worklist->cells[k];
+			memcell_meta_clear(mc, MC_QUEUED_BIT);
+			if(memcell_list(mc) == MC_LIST_HEAP) {
+				gc_par_seed_cell(&par, &chunk, &seeded, mc);
+			}
+		}
+		s->mem_free(s->worklist, s->mem_alloc_priv);
+		s->worklist = next;
 	}
-
-	/* process boundary nodes: move them to reachable */
-	if(! dlist_is_empty(&(s->boundary_list))) {
-		mc = (memcell_t *) dlist_first(&(s->boundary_list));
-		DBGTRACE(TC_GC_TRACING,
-		         "gc (", fmt_u64d(buf, s->iter_count), ") ",
-		         "iter reachable: ", fmt_ptr(buf2, mc), " ");
-		DBGRUN(TC_GC_TRACING, { s->p_cb(mc->data, dbgtrace_getstream()); });
-		assert(!memcell_locked(mc)); // locked nodes should stay in root list
-		assert(memcell_refcount(mc)); // referenced nodes should have refcount
-		s->dl_cb(dl_cb_try_move_boundary, &(mc->data), s);
-		dlnode_remove(&(mc->hdr));
-		memcell_to_reachable(s, mc);
-		goto finish;
+	s->worklist_len = 0;
+	if(chunk) {
+		gc_par_seed(&par, chunk, &seeded);
 	}
 
-	/* check to see if there are any root nodes to process: move their links
-	   to boundary */
-	if(dlist_first(&(s->roots_list)) != &(s->root_sentinel)) {
-		mc = (memcell_t *) dlist_first(&(s->roots_list));
-		DBGTRACE(TC_GC_TRACING,
-		         "gc (", fmt_u64d(buf, s->iter_count), ") ",
-		         "iter root: ", fmt_ptr(buf2, mc), " ");
-		DBGRUN(TC_GC_TRACING, { s->p_cb(mc->data, dbgtrace_getstream()); });
-		s->dl_cb(dl_cb_try_move_boundary, &(mc->data), s);
-		/* after processing, rotate to end of list */
-		dlnode_remove(&(mc->hdr));
-		memcell_to_roots_proc(s, mc);
-		goto finish;
+	/* the roots list cells are traced already: the unlocked ones linked
+	   from others just join the heap, as when a GC step meets them */
+	gc_par_run(&par, GC_PHASE_MARK);
+	for(i = 0; i < par.n; i++) {
+		w = &(par.workers[i]);
+		gc_par_pool_add(&par, w->stack);
+		w->stack = NULL;
+		while((chunk = w->found)) {
+			w->found = chunk->next;
+			for(k = 0; k < chunk->len; k++) {
+				mc = chunk->cells[k];
+				if(memcell_list(mc) == MC_LIST_ROOT && ! memcell_locked(mc)) {
+					memcell_remove(s, mc);
+					memcell_set_list(mc, MC_LIST_HEAP);
+					memcell_mark(s, mc);
+				}
+			}
+			gc_par_pool_add(&par, chunk);
+		}
 	}
+	mclink_remove(&(s->root_sentinel));
+	mclink_insert(&(s->roots_list), &(s->root_sentinel),
+	              mclist_first(&(s->roots_list)));
 
-	/* remaining 'unprocessed' nodes are unreachable: 'free' them */
-	if(! dlist_is_empty(s->unproc_listref)) {
-		mc = (memcell_t *) dlist_first(s->unproc_listref);
 #if defined(GC_REACHABILITY_VERIFICATION)
-		assert(!memcell_reachable(s, mc));
-#endif
-		DBGTRACE(TC_GC_TRACING,
-		         "gc (", fmt_u64d(buf, s->iter_count), ") ",
-		         "iter reachable: ", fmt_ptr(buf2, mc), " ");
-		DBGRUN(TC_GC_TRACING, { s->p_cb(mc->data, dbgtrace_getstream()); });
-		assert(! memcell_locked(mc)); // locked nodes should stay in root list
-		// NB: unreachable can be referenced if e.g. lambda points back to it.
-		s->dl_cb(dl_cb_decref_free_pending_z, &(mc->data), s);
-		memcell_free(s, mc);
-#if defined(NO_GC_FREELIST)
-		DBGTRACELN(TC_MEM_ALLOC,
-		         "gc (", fmt_u64d(buf, s->iter_count), "): ",
-		         "free node (unreachable) ", fmt_ptr(buf2, mc));
-#else /* ! defined(NO_GC_FREELIST) */
-		DBGTRACELN(TC_MEM_ALLOC,
-		         "gc (", fmt_u64d(buf, s->iter_count), "): ",
-		         "free node (unreachable) ", fmt_ptr(buf2, mc), " ",
-		         "nfree=", fmt_u64d(buf3, s->total_free));
-		assert(s->total_free <= s->total_alloc);
-#endif /* ? defined(NO_GC_FREELIST) */
-		goto finish;
+	DLIST_FOR_FWD(&(s->slab_list), slab_cursor) {
+		slab = (memslab_t *) slab_cursor;
+		for(k = 0; k < slab->ncells; k++) {
+			mc = memslab_cell(slab, k);
+			if(gc_par_unreachable(s, mc)) {
+				assert(! memcell_reachable(s, mc));
+			}
+		}
 	}
+#endif /* defined(GC_REACHABILITY_VERIFICATION) */
 
-	/* reset state -- progress root_sentinel, swap reachable/unproc lists */
-	DBGTRACELN(TC_GC_TRACING, "gc iter ** done **: reset state");
-	assert(dlist_first(&(s->roots_list)) == &(s->root_sentinel));
-	dlist_insertlast(&(s->roots_list),
-	                 dlnode_remove(dlist_first(&(s->roots_list))));
-	if(s->reachable_listref == &(s->white_list)) {
-		s->unproc_listref = s->reachable_listref;
-		s->reachable_listref = &(s->black_list);
-	} else {
-		s->unproc_listref = s->reachable_listref;
-		s->reachable_listref = &(s->white_list);
+	par.slabs = s->mem_alloc(s->slab_count * sizeof(*(par.slabs)),
+	                         s->mem_alloc_priv);
+	assert(par.slabs || ! s->slab_count);
+	DLIST_FOR_FWD(&(s->slab_list), slab_cursor) {
+		par.slabs[par.nslabs++] = (memslab_t *) slab_cursor;
 	}
-	status = true;
+	gc_par_run(&par, GC_PHASE_UNLINK);
+	par.next_slab = 0;
+	gc_par_run(&par, GC_PHASE_FREE);
+
+	for(i = 0; i < par.n; i++) {
+		w = &(par.workers[i]);
+		for(j = 0; j < MEMORY_SIZE_CLASSES; j++) {
+			mclist_append(&(s->classes[j].free_list), &(w->free_lists[j]));
+			mclist_append(&(s->region_classes[j].free_list),
+			              &(w->free_lists[MEMORY_SIZE_CLASSES + j]));
+		}
 #if ! defined(NO_GC_STATISTICS)
-	s->cycle_count++;
-#endif
-	s->clean_cycles++;
+		s->total_free += w->freed;
+#endif /* ! defined(NO_GC_STATISTICS) */
+		s->slab_empty += w->emptied;
+		unlinked = unlinked || w->unlinked;
+	}
+	/* what the workers left: cells with finalizers to free and cells no
+	   longer linked, which are only put on the free_pending list now, as
+	   their refcount may have dropped before their linker was swept */
+	for(i = 0; i < par.n; i++) {
+		w = &(par.workers[i]);
+		while((chunk = w->found)) {
+			w->found = chunk->next;
+			for(k = 0; k < chunk->len; k++) {
+				mc = chunk->cells[k];
+				if(gc_par_unreachable(s, mc)) {
+					memcell_free(s, mc);
+				} else {
+					memcell_unreferenced(s, mc);
+				}
+			}
+			gc_par_pool_add(&par, chunk);
+		}
+	}
+	if(unlinked) {
+		s->clean_cycles = 0; // may need to begin cleanup
+	}
+	while(! mclist_is_empty(&(s->free_pending_list))) {
+		mc = (memcell_t *) mclist_first(&(s->free_pending_list));
+		MEMSTATE_LINKS(s, dl_cb_decref_free_pending_z, &(mc->data), s);
+		memcell_free(s, mc);
+	}
+	memstate_cycle_reset(s);
 
-finish:
-	DBGRUN(TC_GC_VERBOSE, {  memory_gc_print_state(s, dbgtrace_getstream()); });
-#if !defined(NDEBUG) /* useless without the non-recursive assertion above */
-	memstate_resetactive(s);
-#endif
-	return status;
+	DBGTRACELN(TC_GC_TRACING,
+	           "gc parallel cycle: threads ", fmt_u64d(buf, par.n), " ",
+	           "nfree=", fmt_u64d(buf2, s->total_free));
+
+cleanup:
+	pthread_mutex_lock(&(par.lock));
+	par.phase = GC_PHASE_EXIT;
+	par.seq++;
+	pthread_cond_broadcast(&(par.cond));
+	pthread_mutex_unlock(&(par.lock));
+	for(i = 0; i < par.n; i++) {
+		w = &(par.workers[i]);
+		pthread_join(w->thread, NULL);
+		pthread_mutex_destroy(&(w->lock));
+		if(w->spare) {
+			gc_par_pool_add(&par, w->spare);
+		}
+	}
+	while((chunk = par.pool)) {
+		par.pool = chunk->next;
+		s->mem_free(chunk, s->mem_alloc_priv);
+	}
+	if(par.slabs) {
+		s->mem_free(par.slabs, s->mem_alloc_priv);
+	}
+	s->mem_free(par.workers, s->mem_alloc_priv);
+	pthread_cond_destroy(&(par.cond));
+	pthread_mutex_destroy(&(par.lock));
+	return par.n;
+}
+#endif /* defined(GC_PARALLEL_CYCLE) */
+
+void memory_gc_cycle_parallel(memory_state_t *s, unsigned int nthreads)
+{
+#if defined(GC_PARALLEL_CYCLE)
+	bool status = true;
+
+	assert(!memstate_isactive(s));
+	if(nthreads) {
+		memstate_setactive(s);
+		memory_gc_rc_flush(s);
+		/* as memory_gc_cycle() after two clean cycles */
+		if(s->clean_cycles < 2) {
+			status = memstate_cycle_parallel(s, nthreads);
+		}
+		memstate_resetactive(s);
+		if(status) {
+			return;
+		}
+	}
+#else
+	(void) nthreads;
+#endif /* defined(GC_PARALLEL_CYCLE) */
+	memory_gc_cycle(s);
 }
 
 
@@ -705,32 +4389,34 @@ static void reachable_helper(void *link, void *p)
 
 	/* recursive depth-first search with loop detection */
 
-	if(mc->mc_flags.searched) {
+	if(MC_GET(mc->rc_flags) & MC_FLAG_SEARCHED) {
 		return;
 	}
 
-	mc->mc_flags.searched = true;
+	memcell_flags_set(mc, MC_FLAG_SEARCHED);
 
 	if(mc == ri->dest) {
 		ri->found = true;
 	} else {
-		ri->s->dl_cb(reachable_helper, &(mc->data), ri);
+		MEMSTATE_LINKS(ri->s, reachable_helper, &(mc->data), ri);
 	}
 
-	mc->mc_flags.searched = false;
+	memcell_flags_clear(mc, MC_FLAG_SEARCHED);
 }
 
 bool memcell_reachable(memory_state_t *s, memcell_t *dst)
 {
 	struct _reach_info_ ri;
-	dlnode_t *cursor;
+	mclink_t *cursor;
+	memcell_t *mc;
+	uintptr_t i;
 
 	ri.found = false;
 	ri.dest = dst;
 	ri.s = s;
 
 	/* see if dst is reachable from any of the root nodes */
-	DLIST_FOR_FWD(&(s->roots_list), cursor) {
+	MCLIST_FOR_FWD(&(s->roots_list), cursor) {
 		if(cursor == &(s->root_sentinel)) {
 			/* skip root sentinel */
 			continue;
@@ -741,6 +4427,23 @@ bool memcell_reachable(memory_state_t *s, memcell_t *dst)
 		}
 	}
 
+	/* and from the root slots */
+	for(i = 0; i < s->shadow_len && ! ri.found; i++) {
+		reachable_helper(*(s->shadow[i]), &ri);
+	}
+
+	/* and from the young cells that are roots of a nursery collection */
+	MCLIST_FOR_FWD(&(s->nursery_list), cursor) {
+		if(ri.found) {
+			break;
+		}
+		mc = (memcell_t *) cursor;
+		if(memcell_refcount(mc) && ! (MC_GET(mc->rc_flags) & MC_FLAG_REMEMBERED)) {
+			continue;
+		}
+		reachable_helper(&(mc->data), &ri);
+	}
+
 	return ri.found;
 }
 
@@ -755,11 +4458,14 @@ static void memcell_print_meta(
 	bool reachable, locked;
 
 	if(memcell_is_free(s, mc)) listname = "free";
-	else if(mc->hdr.owner == &(s->roots_list)) listname = "root";
-	else if(mc->hdr.owner == &(s->boundary_list) )listname = "boundary";
-	else if(mc->hdr.owner == &(s->free_pending_list) )listname = "free_pend";
-	else if(mc->hdr.owner == s->reachable_listref) listname = "reachable";
-	else if(mc->hdr.owner == s->unproc_listref) listname = "unproc";
+	else if(memcell_list(mc) == MC_LIST_ROOT) listname = "root";
+	else if(memcell_list(mc) == MC_LIST_NURSERY) listname = "young";
+	else if(memcell_list(mc) == MC_LIST_DOOMED) listname = "doomed";
+	else if(memcell_list(mc) == MC_LIST_FREE_PENDING) listname = "free_pend";
+	else if(memcell_list(mc) == MC_LIST_FINALIZE) listname = "finalize";
+	else if(memcell_is_unproc(s, mc)) listname = "unproc";
+	else if(MC_GET(mc->meta) & MC_QUEUED_BIT) listname = "boundary";
+	else if(memcell_list(mc) == MC_LIST_HEAP) listname = "reachable";
 	else assert(false);
 
 	refcount = memcell_refcount(mc);
@@ -776,22 +4482,29 @@ static void memcell_print_meta(
 
 void memory_gc_print_state(memory_state_t *state, stream_t *stream)
 {
-	dlnode_t *cursor;
+	mclink_t *cursor;
 	memcell_t *mc;
+	uintptr_t k;
 	char buf[21], buf2[21], buf3[21];
+#if ! defined(NO_GC_FREELIST)
+	dlnode_t *slab_cursor;
+	memslab_t *slab;
+	uintptr_t j;
+	unsigned int i;
+#endif /* ! defined(NO_GC_FREELIST) */
 
 	stream_putln(stream,
 	             "gc (", fmt_s64(buf, state->iter_count), ") ",
 	             "state ", fmt_ptr(buf2, state), " ",
 	             "(", fmt_s64(buf3, state->total_alloc), "):");
 
-	DLIST_FOR_FWD(&(state->free_pending_list), cursor) {
+	MCLIST_FOR_FWD(&(state->free_pending_list), cursor) {
 		mc = (memcell_t *) cursor;
 		memcell_print_meta(state, mc, stream);
 		state->p_cb(mc->data, stream);
 	}
 
-	DLIST_FOR_FWD(&(state->roots_list), cursor) {
+	MCLIST_FOR_FWD(&(state->roots_list), cursor) {
 		if(cursor == &(state->root_sentinel)) {
 			stream_putln(stream, "root sentinel ", fmt_ptr(buf, cursor));
 		} else {
@@ -801,29 +4514,58 @@ void memory_gc_print_state(memory_state_t *state, stream_t *stream)
 		}
 	}
 
-	DLIST_FOR_FWD(&(state->boundary_list), cursor) {
-		mc = (memcell_t *) cursor;
-		memcell_print_meta(state, mc, stream);
-		state->p_cb(mc->data, stream);
+	for(k = 0; k < state->shadow_len; k++) {
+		stream_putln(stream, "shadow root ", fmt_ptr(buf, state->shadow[k]),
+		             " -> ", fmt_ptr(buf2, *(state->shadow[k])));
 	}
 
-	DLIST_FOR_FWD(state->reachable_listref, cursor) {
+	MCLIST_FOR_FWD(&(state->nursery_list), cursor) {
 		mc = (memcell_t *) cursor;
 		memcell_print_meta(state, mc, stream);
 		state->p_cb(mc->data, stream);
 	}
 
-	DLIST_FOR_FWD(state->unproc_listref, cursor) {
+	/* doomed cells may link to ones already freed: no contents */
+	MCLIST_FOR_FWD(&(state->doomed_list), cursor) {
+		memcell_print_meta(state, (memcell_t *) cursor, stream);
+		stream_putln(stream, "");
+	}
+
+#if defined(NO_GC_FREELIST)
+	MCLIST_FOR_FWD(&(state->heap_list), cursor) {
+		if(cursor == &(state->sweep_sentinel)) {
+			stream_putln(stream, "sweep sentinel ", fmt_ptr(buf, cursor));
+			continue;
+		}
 		mc = (memcell_t *) cursor;
 		memcell_print_meta(state, mc, stream);
 		state->p_cb(mc->data, stream);
 	}
+#else /* ! defined(NO_GC_FREELIST) */
+	DLIST_FOR_FWD(&(state->slab_list), slab_cursor) {
+		slab = (memslab_t *) slab_cursor;
+		for(j = 0; j < slab->ncells; j++) {
+			mc = memslab_cell(slab, j);
+			if(memcell_list(mc) == MC_LIST_HEAP) {
+				memcell_print_meta(state, mc, stream);
+				state->p_cb(mc->data, stream);
+			}
+		}
+	}
+#endif /* defined(NO_GC_FREELIST) */
 
 #if ! defined(NO_GC_FREELIST)
-	DLIST_FOR_FWD(&(state->free_list), cursor) {
-		mc = (memcell_t *) cursor;
-		memcell_print_meta(state, mc, stream);
-		state->p_cb(mc->data, stream);
+	for(i = 0; i < MEMORY_SIZE_CLASSES; i++) {
+		MCLIST_FOR_FWD(&(state->classes[i].free_list), cursor) {
+			mc = (memcell_t *) cursor;
+			memcell_print_meta(state, mc, stream);
+			state->p_cb(mc->data, stream);
+		}
+		MCLIST_FOR_FWD(&(state->region_classes[i].free_list), cursor) {
+			mc = (memcell_t *) cursor;
+			memcell_print_meta(state, mc, stream);
+			state->p_cb(mc->data, stream);
+		}
 	}
 #endif
 }
@@ -851,3 +4593,251 @@ uintptr_t memory_gc_count_free(memory_state_t *s)
 	return 0;
 #endif
 }
+
+uintptr_t memory_gc_count_slabs(memory_state_t *s)
+{
+#if ! defined(NO_GC_FREELIST)
+	return s->slab_count;
+#else
+	return 0;
+#endif
+}
+
+uintptr_t memory_gc_count_released_slabs(memory_state_t *s)
+{
+#if ! defined(NO_GC_FREELIST)
+	return s->released_slabs;
+#else
+	return 0;
+#endif
+}
+
+uintptr_t memory_gc_count_released_cells(memory_state_t *s)
+{
+#if ! defined(NO_GC_FREELIST)
+	return s->released_cells;
+#else
+	return 0;
+#endif
+}
+
+uintptr_t memory_gc_count_finalize_queue(memory_state_t *s)
+{
+	return s->finalize_len;
+}
+
+unsigned long long memory_gc_count_finalized(memory_state_t *s)
+{
+	return s->finalized_count;
+}
+
+uintptr_t memory_gc_collect_cycles(memory_state_t *s)
+{
+	uintptr_t freed = 0;
+
+#if defined(GC_CYCLE_COLLECT)
+	assert(!memstate_isactive(s));
+	memstate_setactive(s);
+	memory_gc_rc_flush(s);
+	memstate_trial_deletion(s, &freed);
+	memstate_resetactive(s);
+#else
+	(void) s;
+#endif /* defined(GC_CYCLE_COLLECT) */
+	return freed;
+}
+
+unsigned long long memory_gc_count_trial_passes(memory_state_t *s)
+{
+	return s->trial_passes;
+}
+
+unsigned long long memory_gc_count_trial_freed(memory_state_t *s)
+{
+	return s->trial_freed;
+}
+
+uintptr_t memory_gc_count_weak(memory_state_t *s)
+{
+	return s->weak_count;
+}
+
+unsigned long long memory_gc_count_weak_cleared(memory_state_t *s)
+{
+	return s->weak_cleared;
+}
+
+uintptr_t memory_gc_count_shadow_roots(memory_state_t *s)
+{
+	return s->shadow_len;
+}
+
+uintptr_t memory_gc_count_large(memory_state_t *s)
+{
+	return s->large_len;
+}
+
+uintptr_t memory_gc_count_compacted(memory_state_t *s)
+{
+#if ! defined(NO_GC_FREELIST)
+	return s->compacted_cells;
+#else
+	return 0;
+#endif
+}
+
+void memory_gc_set_trim(memory_state_t *s, uintptr_t high, uintptr_t low)
+{
+#if ! defined(NO_GC_FREELIST)
+	assert(low <= high);
+	s->trim_high = high;
+	s->trim_low = low;
+#else
+	(void) s;
+	(void) high;
+	(void) low;
+#endif
+}
+
+unsigned long long memory_gc_count_minor(memory_state_t *s)
+{
+	return s->minor_count;
+}
+
+unsigned long long memory_gc_count_promoted(memory_state_t *s)
+{
+	return s->promoted_count;
+}
+
+unsigned long long memory_gc_count_young_freed(memory_state_t *s)
+{
+	return s->young_free_count;
+}
+
+void memory_gc_set_nursery(memory_state_t *s, uintptr_t len)
+{
+	s->nursery_len = len;
+	if(! len) {
+		memory_gc_minor(s);
+	}
+}
+
+void memory_gc_set_pace(memory_state_t *s, uintptr_t pace)
+{
+	s->gc_pace = pace;
+	if(! pace) {
+		s->gc_debt = 0;
+	}
+}
+
+uintptr_t memory_gc_pace(memory_state_t *s)
+{
+	return s->gc_pace;
+}
+
+unsigned long long memory_gc_count_paced(memory_state_t *s)
+{
+	return s->paced_iters;
+}
+
+unsigned long long memory_gc_count_paced_cycles(memory_state_t *s)
+{
+	return s->paced_cycles;
+}
+
+void memory_gc_set_adaptive(memory_state_t *s, bool adaptive)
+{
+	s->ms_flags.adaptive = adaptive;
+	s->adapt_budget = 0;
+}
+
+bool memory_gc_adaptive(memory_state_t *s)
+{
+	return s->ms_flags.adaptive;
+}
+
+uintptr_t memory_gc_adapt_requested(memory_state_t *s)
+{
+	return s->adapt_last_requested;
+}
+
+uintptr_t memory_gc_adapt_steps(memory_state_t *s)
+{
+	return s->adapt_last_steps;
+}
+
+unsigned int memory_gc_adapt_free_ratio(memory_state_t *s)
+{
+	return s->adapt_free_ratio;
+}
+
+uintptr_t memory_gc_adapt_budget(memory_state_t *s)
+{
+	return s->adapt_budget;
+}
+
+unsigned long long memory_gc_count_adapted(memory_state_t *s)
+{
+	return s->adapt_count;
+}
+
+unsigned long long memory_gc_count_marker_traced(memory_state_t *s)
+{
+#if defined(GC_CONCURRENT_MARK)
+	unsigned long long traced;
+
+	pthread_mutex_lock(&(s->mark_lock));
+	traced = s->mark_traced;
+	pthread_mutex_unlock(&(s->mark_lock));
+	return traced;
+#else
+	(void) s;
+	return 0;
+#endif /* defined(GC_CONCURRENT_MARK) */
+}
+
+unsigned long long memory_gc_count_rc_advised(memory_state_t *s)
+{
+	return s->rc_advised;
+}
+
+unsigned long long memory_gc_count_rc_applied(memory_state_t *s)
+{
+	return s->rc_applied;
+}
+
+void memory_gc_set_limits(memory_state_t *s, uintptr_t soft, uintptr_t hard)
+{
+	assert(! soft || ! hard || soft <= hard);
+	s->soft_limit = soft;
+	s->hard_limit = hard;
+}
+
+bool memory_gc_oom(memory_state_t *s)
+{
+	return s->ms_flags.oom;
+}
+
+void memory_gc_clear_oom(memory_state_t *s)
+{
+	s->ms_flags.oom = false;
+}
+
+uintptr_t memory_gc_count_heap(memory_state_t *s)
+{
+	return s->heap_len;
+}
+
+unsigned long long memory_gc_count_pressure(memory_state_t *s)
+{
+	return s->pressure_count;
+}
+
+uintptr_t memory_gc_count_region_freed(memory_state_t *s)
+{
+#if ! defined(NO_GC_FREELIST)
+	return s->region_freed;
+#else
+	return 0;
+#endif
+}
@@ -2,25 +2,243 @@
 #define MEMORY_H
 
 #include <stdint.h>
+#include <stddef.h>
 #include "dlist.h"
 #include "stream.h"
 #include "allocator_def.h"
+#if defined(GC_CONCURRENT_MARK) || defined(GC_PARALLEL_CYCLE)
+#include <pthread.h>
+#endif /* defined(GC_CONCURRENT_MARK) || defined(GC_PARALLEL_CYCLE) */
 
 typedef void (*data_fin_t)(void *data);
 
+/* link for the GC state lists. Unlike dlnode_t it does not record the list
+   it is on: that is kept in the owning cell's state bits */
+typedef struct mclink
+{
+	struct mclink *prev, *next;
+} mclink_t;
+
+/* rc_flags: refcount in the high bits, flags in the low bits */
+#define MC_FLAG_LIVE     0x1
+#define MC_FLAG_LOCKED   0x2
+#define MC_FLAG_SEARCHED 0x4
+#define MC_FLAG_REMEMBERED 0x8 /* young, linked from an older cell */
+#define MC_FLAG_EXPORTED 0x10 /* survives the release of its scratch region */
+#define MC_RC_SHIFT      5
+#define MC_RC_ONE        (1 << MC_RC_SHIFT)
+/* the count has 27 bits. A cell with MC_RC_MAX links stays there for good:
+   the count no longer moves, and only a tracing collection frees it */
+#define MC_RC_MAX        (UINT32_MAX >> MC_RC_SHIFT)
+
+/* meta: state list | finalizer index | offset into slab */
+#define MC_LIST_BITS     4
+#define MC_LIST_MASK     ((1 << MC_LIST_BITS) - 1)
+#define MC_LIST_NONE         0
+#define MC_LIST_FREE         1
+#define MC_LIST_ROOT         2
+#define MC_LIST_HEAP         3 /* linked cells, on no list unless NO_GC_FREELIST */
+#define MC_LIST_FREE_PENDING 4
+#define MC_LIST_NURSERY      5
+#define MC_LIST_DOOMED       6 /* unreachable, unlinked by the sweep */
+#define MC_LIST_MOVED        7 /* copied by compaction, forwards to the copy */
+#define MC_LIST_FINALIZE     8 /* unlinked, waiting for its finalizer to run */
+#define MC_FIN_SHIFT     MC_LIST_BITS
+#define MC_FIN_BITS      3
+#define MC_FIN_MASK      (((1 << MC_FIN_BITS) - 1) << MC_FIN_SHIFT)
+/* a heap cell is marked reachable this cycle when its mark bit equals the
+   state's mark epoch, so flipping the epoch unmarks every cell at once */
+#define MC_MARK_SHIFT    7
+#define MC_MARK_BIT      (1 << MC_MARK_SHIFT)
+/* on the boundary worklist: such a cell is never freed until popped */
+#define MC_QUEUED_BIT    (1 << 8)
+/* weak links (memory_gc_weak_link()) point to the cell / are held by it */
+#define MC_WEAK_TARGET_BIT (1 << 9)
+#define MC_WEAK_HOLDER_BIT (1 << 10)
+/* logged as a possible cycle root under GC_CYCLE_COLLECT */
+#define MC_CYCLE_CAND_BIT  (1 << 11)
+#define MC_OFF_SHIFT     12
+#define MC_OFF_GRANULE   8 /* slab offsets are counted in 8 byte units */
+
+/* finalizers are registered once per memory state, cells only record the
+   index of theirs (0 means no finalizer) */
+#define MEMORY_FIN_MAX   (1 << MC_FIN_BITS)
+
+typedef struct
+{
+	mclink_t hdr;
+	uint32_t rc_flags;
+	uint32_t meta;
+	uint64_t data[0];
+} memcell_t;
+
+#if ! defined(MEMORY_SLAB_LEN)
+#define MEMORY_SLAB_LEN (64 * 1024)
+#endif
+#if MEMORY_SLAB_LEN > (MC_OFF_GRANULE << (32 - MC_OFF_SHIFT))
+#error MEMORY_SLAB_LEN too large for cell offset bits
+#endif
+
+/* cells are handed out by size class, in MEMORY_CLASS_GRANULE steps of data
+   length. Each class has its own free list and slab being carved. */
+#if ! defined(MEMORY_SIZE_CLASSES)
+#define MEMORY_SIZE_CLASSES 8
+#endif
+#define MEMORY_CLASS_GRANULE 8
+#define MEMORY_CELL_MAX_LEN (MEMORY_SIZE_CLASSES * MEMORY_CLASS_GRANULE)
+
+#if defined(GC_CONCURRENT_MARK)
+#if defined(NO_GC_FREELIST)
+#error GC_CONCURRENT_MARK needs the slab allocator
+#endif
+/* the marker thread cannot share the meta word with the mutator, so under
+   GC_CONCURRENT_MARK the mark bits live in a bitmap at the head of each
+   slab, one bit per smallest cell */
+#define MEMORY_MARK_GRANULE (sizeof(memcell_t) + MEMORY_CLASS_GRANULE)
+#define MEMORY_MARK_WORDS ((MEMORY_SLAB_LEN / MEMORY_MARK_GRANULE + 63) / 64)
+#endif /* defined(GC_CONCURRENT_MARK) */
+#if defined(GC_PARALLEL_CYCLE) && defined(NO_GC_FREELIST)
+#error GC_PARALLEL_CYCLE needs the slab allocator
+#endif
+
+/* when more than MEMORY_TRIM_HIGH slabs hold only free cells, the GC
+   hands them back to the allocator until MEMORY_TRIM_LOW are left */
+#if ! defined(MEMORY_TRIM_HIGH)
+#define MEMORY_TRIM_HIGH 8
+#endif
+#if ! defined(MEMORY_TRIM_LOW)
+#define MEMORY_TRIM_LOW 2
+#endif
+
+/* memory cells are carved out of large contiguous slabs of MEMORY_SLAB_LEN
+   bytes, each holding cells of a single length. A cell finds its slab, and
+   through it the owning memory state, from the offset in its meta bits. */
 typedef struct
 {
 	dlnode_t hdr;
 	struct memory_state *state;
-	uintptr_t refcount;
-	data_fin_t fin;
-	struct {
-		bool live:1;
-		bool locked:1;
-		bool searched:1;
-	} mc_flags;
-	int data[0];
-} memcell_t;
+	uint32_t id; /* index into the state's slab table */
+	unsigned int cls; /* size class of the cells */
+	bool region; /* holds the cells of the open scratch region */
+	size_t cell_len;
+	uintptr_t ncells; /* cells carved out so far */
+	uintptr_t nfree; /* carved cells currently on the free list */
+	uintptr_t nfin; /* live cells with a finalizer */
+	uintptr_t capacity;
+#if defined(GC_CONCURRENT_MARK)
+	uint64_t marks[MEMORY_MARK_WORDS];
+#endif /* defined(GC_CONCURRENT_MARK) */
+	uint64_t cells[0];
+} memslab_t;
+
+/* new cells start out in the nursery instead of the roots list. When it holds
+   MEMORY_NURSERY_LEN cells (0 disables the nursery) it is collected in one
+   batch: young cells reachable from the C stack or from older cells are
+   promoted into the incremental heap and the rest are freed. */
+#if ! defined(MEMORY_NURSERY_LEN)
+#define MEMORY_NURSERY_LEN 1024
+#endif
+
+/* GC work is paced by allocation: every memory_request() adds the length of
+   the cell (header included) times the pace to the GC debt, and runs a GC
+   step for each MEMORY_PACE_UNIT of debt. The pace is thus in GC steps per
+   KiB requested; 0 leaves collection to explicit memory_gc_iterate() calls. */
+#if ! defined(MEMORY_GC_PACE)
+#define MEMORY_GC_PACE 64
+#endif
+#define MEMORY_PACE_UNIT 1024
+
+/* adaptive pacing (memory_gc_set_adaptive()) picks the pace again at the end
+   of every cycle: the one at which the steps the cycle took are paid for by
+   requesting the bytes of the free cells left, plus 1/MEMORY_ADAPT_GROWTH of
+   the heap. A starved free list thus speeds the GC up, and a heap of live
+   cells slows it down as it grows. The pace is kept within
+   MEMORY_ADAPT_PACE_MIN and MEMORY_ADAPT_PACE_MAX. */
+#if ! defined(MEMORY_ADAPT_GROWTH)
+#define MEMORY_ADAPT_GROWTH 4
+#endif
+#if ! defined(MEMORY_ADAPT_PACE_MIN)
+#define MEMORY_ADAPT_PACE_MIN 4
+#endif
+#if ! defined(MEMORY_ADAPT_PACE_MAX)
+#define MEMORY_ADAPT_PACE_MAX 4096
+#endif
+
+/* memory_gc_iterate_n() checks its time budget every this many steps */
+#if ! defined(MEMORY_SLICE_CLOCK_STEPS)
+#define MEMORY_SLICE_CLOCK_STEPS 32
+#endif
+
+typedef struct
+{
+	mclink_t free_list;
+	memslab_t *slab_cur;
+} memclass_t;
+
+/* marked cells whose links are still to be traced (the boundary) are kept
+   on a stack of fixed size chunks */
+#if ! defined(MEMORY_WORKLIST_CHUNK)
+#define MEMORY_WORKLIST_CHUNK 510 /* 4KiB chunks on 64-bit */
+#endif
+
+typedef struct memchunk
+{
+	struct memchunk *next;
+	uintptr_t len;
+	memcell_t *cells[MEMORY_WORKLIST_CHUNK];
+} memchunk_t;
+
+/* the marker thread keeps this many spare worklist chunks, as it cannot use
+   the state's allocator itself */
+#if ! defined(MEMORY_MARK_POOL)
+#define MEMORY_MARK_POOL 4
+#endif
+
+/* the sweep looks at up to this many cells per GC step */
+#if ! defined(MEMORY_SWEEP_SCAN)
+#define MEMORY_SWEEP_SCAN 32
+#endif
+
+/* under GC_DEFERRED_RC link advice from the mutator is not applied to the
+   refcounts right away: it is logged per cell into a table of
+   (1 << MEMORY_RC_LOG_BITS) entries, where the increments and decrements of
+   a cell cancel out, and only the net change is applied when the log is
+   flushed. That happens when it is 3/4 full and whenever the GC runs. */
+#if ! defined(MEMORY_RC_LOG_BITS)
+#define MEMORY_RC_LOG_BITS 8
+#endif
+#define MEMORY_RC_LOG_LEN (1 << MEMORY_RC_LOG_BITS)
+
+typedef struct
+{
+	memcell_t *mc;
+	int32_t delta;
+} memrc_entry_t;
+
+/* refcounts alone never free a cycle. Under GC_CYCLE_COLLECT a heap cell
+   whose refcount drops, but not to zero, may have lost the last link into
+   a cycle of garbage: it is logged as a candidate in a table of
+   (1 << MEMORY_CYCLE_LOG_BITS) entries, young cells included. Once that is
+   3/4 full the next GC step or memory request runs a trial deletion pass:
+   it collects the nursery if a candidate is young, takes the heap cells
+   reachable from the candidates, up to MEMORY_CYCLE_SCAN of them, subtracts
+   the links between them from their refcounts, and frees the ones that
+   neither have a link left from outside nor are linked from one that has. */
+#if ! defined(MEMORY_CYCLE_LOG_BITS)
+#define MEMORY_CYCLE_LOG_BITS 8
+#endif
+#define MEMORY_CYCLE_LOG_LEN (1 << MEMORY_CYCLE_LOG_BITS)
+#if ! defined(MEMORY_CYCLE_SCAN)
+#define MEMORY_CYCLE_SCAN 4096
+#endif
+
+/* a cell taken by the trial deletion pass */
+typedef struct
+{
+	memcell_t *mc;
+	uint32_t internal; /* links to it from the other cells taken */
+	bool live;
+} memtrial_entry_t;
 
 /* must do something like
 	foreach link from *data:
@@ -31,6 +249,42 @@ typedef void (*data_link_callback)(
 	void *data,
 	void *p);
 
+/* must do something like
+	foreach link field in *data:
+		field = fix(field, p)
+*/
+typedef void (*data_relocate_callback)(
+	void *(*fix)(void *link, void *p),
+	void *data,
+	void *p);
+
+/* weak link table entry, free when target is NULL */
+typedef struct
+{
+	memcell_t *target;
+	memcell_t *holder;
+} memweak_entry_t;
+
+/* the weak link table starts at this many entries and doubles whenever it
+   gets half full */
+#if ! defined(MEMORY_WEAK_MIN_LEN)
+#define MEMORY_WEAK_MIN_LEN 64
+#endif
+
+/* the shadow root array starts at this many slots and doubles when full */
+#if ! defined(MEMORY_SHADOW_MIN_LEN)
+#define MEMORY_SHADOW_MIN_LEN 64
+#endif
+
+/* a large object is mapped on its own, this header ahead of its data */
+typedef struct
+{
+	dlnode_t hdr;
+	size_t len; /* of the mapping, header included */
+} memlarge_t;
+
+#define MEMORY_LARGE_HDR_LEN ((sizeof(memlarge_t) + 15) & ~(size_t) 15)
+
 typedef void (*print_callback)(void *data, stream_t *stream);
 
 typedef void (*init_callback)(void *data);
@@ -46,20 +300,112 @@ struct memory_state
 	unsigned int clean_cycles;
 	unsigned long long skipped_clean_iters;
 #if ! defined(NO_GC_FREELIST)
-	dlist_t free_list;
+	memclass_t classes[MEMORY_SIZE_CLASSES];
+	memclass_t region_classes[MEMORY_SIZE_CLASSES];
+	dlist_t slab_list;
+	uintptr_t slab_count;
+	memslab_t **slab_table; /* by slab id, for decoding memory_ref_t */
+	uintptr_t slab_table_len;
+	uintptr_t slab_id_hint; /* no unused slab id below this */
+	memslab_t *slab_reserve; /* for when the allocator fails */
+	uintptr_t slab_empty; /* slabs with every carved cell free */
+	uintptr_t trim_high, trim_low;
+	uintptr_t released_slabs;
+	uintptr_t released_cells;
+	uintptr_t region_freed;
+	uintptr_t compacted_cells;
 #endif /* ! defined(NO_GC_FREELIST) */
-	dlnode_t root_sentinel;
-	dlist_t roots_list;
-	dlist_t boundary_list;
-	dlist_t free_pending_list;
-	dlist_t white_list, black_list;
-	dlist_t *reachable_listref;
-	dlist_t *unproc_listref;
+	mclink_t root_sentinel;
+	mclink_t roots_list;
+	memchunk_t *worklist, *worklist_spare;
+	uintptr_t worklist_len;
+	mclink_t free_pending_list;
+#if defined(NO_GC_FREELIST)
+	mclink_t heap_list; /* there are no slabs to sweep */
+	mclink_t sweep_sentinel;
+#else
+	dlnode_t *sweep_slab;
+	uintptr_t sweep_index;
+#endif /* defined(NO_GC_FREELIST) */
+	unsigned int mark_epoch; /* 0 or 1 */
+	mclink_t doomed_list;
+	mclink_t finalize_list; /* freed cells whose finalizers are deferred */
+	uintptr_t finalize_len;
+	unsigned long long finalized_count;
+	mclink_t nursery_list;
+	uintptr_t nursery_count, nursery_len;
+	unsigned long long minor_count;
+	unsigned long long promoted_count;
+	unsigned long long young_free_count;
+	uintptr_t heap_len; /* bytes of cell memory taken from the allocator */
+	uintptr_t soft_limit, hard_limit; /* in bytes of heap_len, 0 is none */
+	unsigned long long pressure_count;
+	uintptr_t gc_pace; /* GC steps per MEMORY_PACE_UNIT bytes requested */
+	uintptr_t gc_debt; /* in bytes requested times gc_pace */
+	unsigned long long paced_iters;
+	unsigned long long paced_cycles; /* cycles every step of which was paced */
+	uintptr_t adapt_requested, adapt_steps; /* in the cycle in progress */
+	uintptr_t adapt_last_requested, adapt_last_steps; /* in the last one */
+	uintptr_t adapt_budget; /* bytes the pace was picked for */
+	unsigned int adapt_free_ratio; /* percent of cells free at the end */
+	unsigned long long adapt_count;
+#if defined(GC_DEFERRED_RC)
+	memrc_entry_t rc_log[MEMORY_RC_LOG_LEN];
+	uint16_t rc_log_used[MEMORY_RC_LOG_LEN]; /* taken entries, in order */
+	uintptr_t rc_log_count;
+#endif /* defined(GC_DEFERRED_RC) */
+#if defined(GC_CYCLE_COLLECT)
+	memcell_t *cycle_log[MEMORY_CYCLE_LOG_LEN]; /* open addressing */
+	uintptr_t cycle_log_count; /* entries taken, forgotten ones included */
+	/* allocated by the first pass: the cells it takes (2 * MEMORY_CYCLE_SCAN
+	   entries, by cell), then their order and a stack (MEMORY_CYCLE_SCAN
+	   each) */
+	memtrial_entry_t *trial_table;
+	memtrial_entry_t **trial_order;
+#endif /* defined(GC_CYCLE_COLLECT) */
+	unsigned long long trial_passes;
+	unsigned long long trial_freed;
+#if defined(GC_CONCURRENT_MARK)
+	/* everything the marker thread shares with the mutator is under
+	   mark_lock, except the mark bits */
+	pthread_t mark_thread;
+	pthread_mutex_t mark_lock;
+	pthread_cond_t mark_cond;
+	memchunk_t *mark_queue; /* cells handed to the marker, to trace */
+	memchunk_t *mark_returned; /* unlocked roots it found linked */
+	memchunk_t *mark_pool; /* spare chunks for the marker */
+	uintptr_t mark_pool_len;
+	uintptr_t mark_outstanding; /* chunks queued or being traced */
+	unsigned long long mark_traced; /* cells traced by the marker */
+	bool mark_running, mark_stop, mark_need_chunks;
+#endif /* defined(GC_CONCURRENT_MARK) */
+	memweak_entry_t *weak_table; /* by target, open addressing */
+	uintptr_t weak_len; /* entries in weak_table, 0 before the first link */
+	uintptr_t weak_count; /* entries in use */
+	unsigned long long weak_cleared;
+	void ***shadow; /* addresses of the registered root slots, in push order */
+	uintptr_t shadow_len, shadow_cap;
+	dlist_t large_list;
+	uintptr_t large_len; /* bytes mapped for large objects, in heap_len */
+	unsigned long long rc_advised; /* link advice calls */
+	unsigned long long rc_applied; /* refcount updates made for them */
+	data_fin_t fin_table[MEMORY_FIN_MAX];
 	init_callback i_cb;
 	data_link_callback dl_cb;
+	data_relocate_callback r_cb;
 	print_callback p_cb;
 	struct {
-		bool active:1;
+		bool active:1; /* GC work is running, which does not nest */
+		bool trimming:1;
+		bool nursery_swept:1; /* nursery promoted this cycle before sweep */
+		bool oom:1; /* heap grew past hard_limit */
+		bool region:1; /* a scratch region is open */
+		bool sweeping:1; /* from the start of the sweep to the cycle end */
+		bool defer_fin:1; /* queue finalizable cells instead of freeing */
+		bool shadow_scanned:1; /* root slots traced this cycle */
+		bool adaptive:1; /* pick the pace at the end of each cycle */
+		bool pacing:1; /* steps run now pay allocation debt */
+		bool unpaced:1; /* a step of this cycle was run explicitly */
 	} ms_flags;
 	mem_allocator_fn_t mem_alloc;
 	mem_free_fn_t mem_free;
@@ -67,25 +413,50 @@ struct memory_state
 };
 typedef struct memory_state memory_state_t;
 
-/* initialize memory state */
+/* initialize memory state (r_cb may be NULL, which rules out compaction and
+   weak links). r_cb must rewrite weak link fields as well as strong ones.
+   Built with GC_INLINE_LINKS, the GC enumerates links as node_links.h does
+   rather than calling dl_cb, so the cells must be nodes. */
 void memory_state_init(
 	memory_state_t *s,
 	init_callback i_cb,
 	data_link_callback dl_cb,
+	data_relocate_callback r_cb,
 	print_callback p_cb,
 	mem_allocator_fn_t mem_alloc,
 	mem_free_fn_t mem_free,
 	void *mem_alloc_priv);
 
+/* tear the state down: every cell is freed, whether reachable or not. Only
+   the cells with a finalizer are visited, to run it, found through the slabs
+   counting them; the slabs then go back to the allocator whole. */
 void memory_state_reset(
 	memory_state_t *s);
 
 memory_state_t *data_to_memstate(void *data);
 
-/* request memory from the GC */
+/* request memory from the GC (len <= MEMORY_CELL_MAX_LEN) */
 void *memory_request(memory_state_t *s, size_t len);
-/* attach finalizer callback to memory cell */
-void memory_set_finalizer(void *data, data_fin_t fin);
+/* attach finalizer callback to memory cell (NULL detaches it). A state holds
+   up to MEMORY_FIN_MAX - 1 distinct finalizers: past that this returns
+   false, and the cell keeps the finalizer it had.
+   A finalizer run by a GC step, a nursery collection or a trial deletion
+   pass may request memory: the GC work that would pay for it waits for a
+   later request, and heap pressure collects nothing meanwhile. It must not
+   run the GC itself. Finalizers run by memory_region_release() or
+   memory_state_reset() must not request memory. */
+bool memory_set_finalizer(void *data, data_fin_t fin);
+
+/* large objects: byte buffers too big for a cell, each mmap()ed on its own
+   and unmapped when returned. Their pages count toward heap_len, so they pay
+   GC debt and are held to the heap limits like cells. The GC does not trace
+   or free them: the cell owning one returns it, from its finalizer say, and
+   memory_state_reset() unmaps any left. Returns NULL if mmap() fails. */
+void *memory_large_request(memory_state_t *s, size_t len);
+/* (NULL noop) */
+void memory_large_return(memory_state_t *s, void *addr);
+/* bytes mapped for large objects */
+uintptr_t memory_gc_count_large(memory_state_t *s);
 
 bool memory_gc_is_locked(void *data);
 /* this memory should never be freed (not NULL) */
@@ -97,17 +468,40 @@ void memory_gc_unlock(memory_state_t *s, void *data);
 void memory_gc_advise_new_link(memory_state_t *s, void *data);
 /* tell the GC that a new link to data has been removed (NULL noop) */
 void memory_gc_advise_stale_link(memory_state_t *s, void *data);
+/* write barrier: tell the GC that holder, which already existed, now links
+   to data (NULL noop). Must be called for every link not set up when the
+   holder was created. */
+void memory_gc_write_barrier(memory_state_t *s, void *holder, void *data);
 
-/* indicate whether data is a root node (false if NULL) */
+/* indicate whether data is a root node, young nodes are unlocked roots
+   (false if NULL) */
 bool memory_gc_isroot(memory_state_t *s, void *data);
 /* indicate whether data is not in a freed node (false if NULL) */
 bool memory_gc_islive(memory_state_t *s, void *data);
 
+/* true while GC work runs, e.g. for a finalizer it runs, which must not run
+   the GC in turn */
+bool memory_gc_active(memory_state_t *s);
 /* run the GC one iteration, return true on cycle complete */
 bool memory_gc_iterate(memory_state_t *s);
+/* run up to n GC iterations, or until ns nanoseconds have passed (0 is no
+   limit for either), stopping early once there is nothing left to collect.
+   Returns the iterations run. */
+uintptr_t memory_gc_iterate_n(
+	memory_state_t *s,
+	uintptr_t n,
+	unsigned long long ns);
+/* collect the nursery now */
+void memory_gc_minor(memory_state_t *s);
 /* run the GC one cycle */
 static inline void memory_gc_cycle(memory_state_t *s)
 	{ while(!memory_gc_iterate(s)); }
+/* run one GC cycle with the world stopped, tracing and then sweeping on
+   nthreads worker threads that take work from each other. A cycle already
+   sweeping is finished first, on the calling thread, which also runs the
+   finalizers. Without GC_PARALLEL_CYCLE (or with nthreads 0) this is
+   memory_gc_cycle(). */
+void memory_gc_cycle_parallel(memory_state_t *s, unsigned int nthreads);
 
 bool memcell_reachable(memory_state_t *s, memcell_t *dst);
 
@@ -117,5 +511,208 @@ unsigned long long memory_gc_count_iters(memory_state_t *s);
 unsigned long long memory_gc_count_cycles(memory_state_t *s);
 uintptr_t memory_gc_count_total(memory_state_t *s);
 uintptr_t memory_gc_count_free(memory_state_t *s);
+uintptr_t memory_gc_count_slabs(memory_state_t *s);
+uintptr_t memory_gc_count_released_slabs(memory_state_t *s);
+uintptr_t memory_gc_count_released_cells(memory_state_t *s);
+unsigned long long memory_gc_count_minor(memory_state_t *s);
+unsigned long long memory_gc_count_promoted(memory_state_t *s);
+unsigned long long memory_gc_count_young_freed(memory_state_t *s);
+
+/* set the number of young cells that triggers a nursery collection (0 puts
+   new cells straight into the roots list) */
+void memory_gc_set_nursery(memory_state_t *s, uintptr_t len);
+
+/* limit the bytes of cell memory the state takes from its allocator (0 is no
+   limit). Before growing past the soft limit the GC collects the nursery and
+   runs full cycles to free cells instead. Growing past the hard limit still
+   succeeds, so callers never see NULL, but marks the state out of memory:
+   eval checks that at each step and unwinds with EVAL_ERR_OUT_OF_MEM. */
+void memory_gc_set_limits(memory_state_t *s, uintptr_t soft, uintptr_t hard);
+/* true once the heap has grown past the hard limit, until cleared */
+bool memory_gc_oom(memory_state_t *s);
+void memory_gc_clear_oom(memory_state_t *s);
+uintptr_t memory_gc_count_heap(memory_state_t *s);
+unsigned long long memory_gc_count_pressure(memory_state_t *s);
+
+/* set the GC steps run per KiB of cells requested (see MEMORY_GC_PACE), may
+   be changed at any time */
+void memory_gc_set_pace(memory_state_t *s, uintptr_t pace);
+uintptr_t memory_gc_pace(memory_state_t *s);
+/* GC steps run to pay off allocation debt, and cycles run by those alone */
+unsigned long long memory_gc_count_paced(memory_state_t *s);
+unsigned long long memory_gc_count_paced_cycles(memory_state_t *s);
+/* let the GC pick its own pace (see MEMORY_ADAPT_GROWTH), starting from the
+   one set. It only learns from paced cycles: one with a step run by
+   memory_gc_iterate() or memory_gc_cycle() leaves the pace as it is, and so
+   does memory_gc_cycle_parallel(). It is thus inert at pace 0 (as under
+   NODE_NO_INCREMENTAL_GC), and has next to nothing to go by where cycles
+   are run explicitly (as under NODE_INCREMENTAL_FULL_GC). Under
+   NO_GC_FREELIST or NO_GC_STATISTICS there is no free cell count, so it goes
+   by the heap length alone. */
+void memory_gc_set_adaptive(memory_state_t *s, bool adaptive);
+bool memory_gc_adaptive(memory_state_t *s);
+/* what the last cycle fed it: bytes requested and GC steps run during the
+   cycle, percent of cells free at its end; and the bytes requested it picked
+   the current pace for */
+uintptr_t memory_gc_adapt_requested(memory_state_t *s);
+uintptr_t memory_gc_adapt_steps(memory_state_t *s);
+unsigned int memory_gc_adapt_free_ratio(memory_state_t *s);
+uintptr_t memory_gc_adapt_budget(memory_state_t *s);
+/* cycle ends at which the pace was changed */
+unsigned long long memory_gc_count_adapted(memory_state_t *s);
+
+/* start a thread that traces the heap in the background, where the GC
+   steps would otherwise trace the boundary cells themselves. GC steps still
+   find the roots, and do all the freeing, so finalizers run on the calling
+   thread. Returns false unless built with GC_CONCURRENT_MARK (and the
+   thread could be started). The marker is stopped by memory_state_reset(). */
+bool memory_gc_start_marker(memory_state_t *s);
+void memory_gc_stop_marker(memory_state_t *s);
+/* snapshot-at-the-beginning barrier: an existing cell's link to old is
+   being overwritten. While the marker thread runs, old is kept for this
+   cycle (NULL noop). */
+#if defined(GC_CONCURRENT_MARK)
+void memory_gc_overwrite_barrier(memory_state_t *s, void *old);
+#else
+static inline void memory_gc_overwrite_barrier(memory_state_t *s, void *old)
+	{ (void) s; (void) old; }
+#endif /* defined(GC_CONCURRENT_MARK) */
+/* cells traced by the marker thread */
+unsigned long long memory_gc_count_marker_traced(memory_state_t *s);
+
+/* apply the link advice logged under GC_DEFERRED_RC (noop otherwise) */
+void memory_gc_rc_flush(memory_state_t *s);
+/* link advice received from the mutator, and the refcount updates that were
+   made for it: these only differ under GC_DEFERRED_RC */
+unsigned long long memory_gc_count_rc_advised(memory_state_t *s);
+unsigned long long memory_gc_count_rc_applied(memory_state_t *s);
+
+/* run the GC_CYCLE_COLLECT trial deletion pass over the logged candidates
+   now, instead of when the log fills up. Returns the cells freed (always 0
+   without GC_CYCLE_COLLECT). */
+uintptr_t memory_gc_collect_cycles(memory_state_t *s);
+/* trial deletion passes run, cells they freed */
+unsigned long long memory_gc_count_trial_passes(memory_state_t *s);
+unsigned long long memory_gc_count_trial_freed(memory_state_t *s);
+
+/* deferred finalizers: cells with a finalizer are not finalized and freed
+   by the GC step that finds them unreachable, but queued until
+   memory_gc_run_finalizers(), so slow finalizers run at points the caller
+   chooses rather than in the middle of whatever allocation paid for the GC
+   step. Turning deferral off runs the queue. memory_state_reset() runs it
+   either way. */
+void memory_gc_defer_finalizers(memory_state_t *s, bool defer);
+/* run up to n queued finalizers (0 is no limit) and free their cells,
+   returns the finalizers run */
+uintptr_t memory_gc_run_finalizers(memory_state_t *s, uintptr_t n);
+/* cells queued for their finalizer, finalizers run from the queue */
+uintptr_t memory_gc_count_finalize_queue(memory_state_t *s);
+unsigned long long memory_gc_count_finalized(memory_state_t *s);
+
+/* scratch regions: cells requested between memory_region_begin() and
+   memory_region_release() are carved from slabs of their own. Releasing the
+   region frees them in one pass, without tracing or waiting for a GC cycle,
+   except for the cells reachable from a locked or exported cell. A region
+   cell stored into an older cell (through the write barrier) is exported
+   automatically. The survivors join the ordinary heap. Regions do not nest.
+   Under NO_GC_FREELIST region cells are simply left to the GC. */
+void memory_region_begin(memory_state_t *s);
+/* keep data, and the region cells it links to, past the region release. It
+   still needs a link or a lock to stay alive after that (NULL noop) */
+void memory_region_export(memory_state_t *s, void *data);
+void memory_region_release(memory_state_t *s);
+uintptr_t memory_gc_count_region_freed(memory_state_t *s);
+
+/* compaction: finish a GC cycle, then copy every heap cell reachable from
+   the roots into fresh slabs, depth first with the last link first, so the
+   spine of a list ends up in consecutive cells. Links are fixed up through
+   the relocate callback, and the slabs left empty are released down to the
+   trim low mark. Roots, locked cells among them, stay where they are.
+   Returns the cells moved: 0 without a relocate callback, while a scratch
+   region is open, or under NO_GC_FREELIST.
+   Only call this where every cell the C stack points to is locked, held in
+   a shadow root slot or was never linked, e.g. between top level
+   evaluations. */
+uintptr_t memory_gc_compact(memory_state_t *s);
+/* percentage of free cells among those carved from slabs still in use, to
+   decide when to compact */
+unsigned int memory_gc_fragmentation(memory_state_t *s);
+uintptr_t memory_gc_count_compacted(memory_state_t *s);
+
+/* weak links: a link from holder to target that the data link callback
+   does not report and that does not count toward target's refcount, so it
+   does not keep target alive. When target is freed, the relocate callback
+   is run on every holder with a fix that returns NULL for target, which
+   clears the weak link fields. The holder must unlink before it drops or
+   replaces the link; freeing the holder unlinks it. Needs a relocate
+   callback (target NULL noop). */
+void memory_gc_weak_link(memory_state_t *s, void *holder, void *target);
+void memory_gc_weak_unlink(memory_state_t *s, void *holder, void *target);
+/* target, or NULL if the GC has found it unreachable but not freed it yet:
+   weak links must be read through this, so they never bring back garbage
+   (NULL noop) */
+void *memory_gc_weak_get(memory_state_t *s, void *target);
+/* weak links in the table, weak links cleared by the GC */
+uintptr_t memory_gc_count_weak(memory_state_t *s);
+unsigned long long memory_gc_count_weak_cleared(memory_state_t *s);
+
+/* shadow stack roots: slots outside the heap (C locals, say) that link to
+   cells and keep them alive, registered in one array the GC scans once per
+   cycle, instead of being locked handle cells on the roots list.
+   memory_gc_roots_push() registers n consecutive slots and clears them,
+   memory_gc_roots_pop() clears and drops the last n registered, which must
+   be the same slots. A registered slot is only written through
+   memory_gc_root_set(), which advises the link (data may be NULL). */
+void memory_gc_roots_push(memory_state_t *s, void **slots, uintptr_t n);
+void memory_gc_roots_pop(memory_state_t *s, void **slots, uintptr_t n);
+void memory_gc_root_set(memory_state_t *s, void **slot, void *data);
+/* slots registered */
+uintptr_t memory_gc_count_shadow_roots(memory_state_t *s);
+
+/* set the empty slab high-water mark that starts trimming, and the number
+   of empty slabs trimming leaves behind (low <= high) */
+void memory_gc_set_trim(memory_state_t *s, uintptr_t high, uintptr_t low);
+
+#if ! defined(NO_GC_FREELIST)
+/* 32-bit reference to a cell: slab id in the high bits, offset of the cell
+   into its slab (in MC_OFF_GRANULE units) in the low bits. 0 is NULL. */
+typedef uint32_t memory_ref_t;
+
+#define MEMORY_REF_OFF_BITS 13
+#define MEMORY_REF_OFF_MASK ((1 << MEMORY_REF_OFF_BITS) - 1)
+#if MEMORY_SLAB_LEN > (MC_OFF_GRANULE << MEMORY_REF_OFF_BITS)
+#error MEMORY_SLAB_LEN too large for memory_ref_t offset bits
+#endif
+/* slab ids start at 1 so that no cell encodes to 0 */
+#define MEMORY_REF_MAX_SLABS (1UL << (32 - MEMORY_REF_OFF_BITS))
+
+static inline memory_ref_t memory_data_to_ref(void *data)
+{
+	memcell_t *mc;
+	memslab_t *slab;
+	uint32_t off;
+
+	if(! data) {
+		return 0;
+	}
+	mc = (memcell_t *) ((char *) data - offsetof(memcell_t, data));
+	off = mc->meta >> MC_OFF_SHIFT;
+	slab = (memslab_t *) ((char *) mc - off * MC_OFF_GRANULE);
+	return (slab->id << MEMORY_REF_OFF_BITS) | off;
+}
+
+static inline void *memory_ref_to_data(memory_state_t *s, memory_ref_t ref)
+{
+	memslab_t *slab;
+
+	if(! ref) {
+		return NULL;
+	}
+	slab = s->slab_table[ref >> MEMORY_REF_OFF_BITS];
+	return (char *) slab
+	       + (ref & MEMORY_REF_OFF_MASK) * MC_OFF_GRANULE
+	       + offsetof(memcell_t, data);
+}
+#endif /* ! defined(NO_GC_FREELIST) */
 
 #endif
@@ -0,0 +1,218 @@
+#define _DEFAULT_SOURCE /* MAP_ANONYMOUS and madvise() under --std=c99 */
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <assert.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "libc_custom.h"
+#include "traceclass.h"
+#include "dbgtrace.h"
+#include "mmap_arena.h"
+
+#if ! defined(MAP_ANONYMOUS)
+#define MAP_ANONYMOUS MAP_ANON
+#endif
+
+mmarena_state_t *mmarena_state_init(
+	void *p,
+	size_t chunk_len,
+	size_t arena_len,
+	unsigned int flags,
+	mem_allocator_fn_t mem_alloc,
+	mem_free_fn_t mem_free,
+	void *alloc_p)
+{
+	mmarena_state_t *state = (mmarena_state_t *) p;
+
+	if(! arena_len) {
+		arena_len = MMARENA_DEFAULT_LEN;
+	}
+	arena_len = (arena_len + MMARENA_ALIGN - 1) & ~(size_t) (MMARENA_ALIGN - 1);
+	assert(chunk_len >= sizeof(void *));
+	assert(chunk_len % sizeof(void *) == 0);
+	assert(chunk_len <= arena_len);
+
+	if(state) {
+		dlist_init(&(state->arena_list));
+		state->chunk_len = chunk_len;
+		state->arena_len = arena_len;
+		state->flags = flags;
+		state->mem_alloc = mem_alloc;
+		state->mem_free = mem_free;
+		state->alloc_p = alloc_p;
+		state->arena_count = 0;
+		state->chunk_count = 0;
+	}
+
+	return state;
+}
+
+/* map a new arena aligned to MMARENA_ALIGN: map an extra MMARENA_ALIGN
+   bytes and unmap whatever hangs over on either side */
+static mmarena_t *mmarena_new(mmarena_state_t *state)
+{
+	mmarena_t *arena;
+	char *map, *base;
+	size_t map_len = state->arena_len + MMARENA_ALIGN;
+	size_t head, page, off;
+	DBGSTMT(char buf[21]);
+	DBGSTMT(char buf2[21]);
+
+	arena = state->mem_alloc(sizeof(*arena), state->alloc_p);
+	if(! arena) {
+		return NULL;
+	}
+	map = mmap(NULL, map_len, PROT_READ | PROT_WRITE,
+	           MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if(map == MAP_FAILED) {
+		state->mem_free(arena, state->alloc_p);
+		return NULL;
+	}
+	base = (char *) (((uintptr_t) map + MMARENA_ALIGN - 1)
+	                 & ~(uintptr_t) (MMARENA_ALIGN - 1));
+	head = base - map;
+	if(head) {
+		munmap(map, head);
+	}
+	if(map_len - head > state->arena_len) {
+		munmap(base + state->arena_len, map_len - head - state->arena_len);
+	}
+
+#if defined(MADV_HUGEPAGE)
+	if(state->flags & MMARENA_HUGEPAGE) {
+		/* only advice: the kernel may still back the arena with small pages */
+		madvise(base, state->arena_len, MADV_HUGEPAGE);
+	}
+#endif /* defined(MADV_HUGEPAGE) */
+	if(state->flags & MMARENA_PREFAULT) {
+		page = sysconf(_SC_PAGESIZE);
+		for(off = 0; off < state->arena_len; off += page) {
+			((volatile char *) base)[off] = 0;
+		}
+	}
+
+	dlnode_init(&(arena->hdr));
+	arena->base = base;
+	arena->len = state->arena_len;
+	arena->carved = 0;
+	arena->used = 0;
+	arena->free_list = NULL;
+	dlist_insertlast(&(state->arena_list), &(arena->hdr));
+	state->arena_count++;
+	DBGTRACELN(TC_ARENA_ALLOC,
+	           "mmarena: new arena ", fmt_ptr(buf, base), " ",
+	           "narenas=", fmt_u64d(buf2, state->arena_count));
+	return arena;
+}
+
+static void mmarena_release(mmarena_state_t *state, mmarena_t *arena)
+{
+	DBGSTMT(char buf[21]);
+	DBGSTMT(char buf2[21]);
+
+	dlnode_remove(&(arena->hdr));
+	munmap(arena->base, arena->len);
+	state->arena_count--;
+	DBGTRACELN(TC_ARENA_ALLOC,
+	           "mmarena: release arena ", fmt_ptr(buf, arena->base), " ",
+	           "narenas=", fmt_u64d(buf2, state->arena_count));
+	state->mem_free(arena, state->alloc_p);
+}
+
+void mmarena_state_reset(mmarena_state_t *state)
+{
+	while(! dlist_is_empty(&(state->arena_list))) {
+		mmarena_release(state, (mmarena_t *) dlist_first(&(state->arena_list)));
+	}
+	state->chunk_count = 0;
+}
+
+static mmarena_t *mmarena_find(mmarena_state_t *state, void *p)
+{
+	dlnode_t *cursor;
+	mmarena_t *arena;
+
+	DLIST_FOR_FWD(&(state->arena_list), cursor) {
+		arena = (mmarena_t *) cursor;
+		if((char *) p >= arena->base && (char *) p < arena->base + arena->len) {
+			return arena;
+		}
+	}
+	return NULL;
+}
+
+void *mmarena_request(size_t len, void *mmarena_state)
+{
+	mmarena_state_t *state = (mmarena_state_t *) mmarena_state;
+	dlnode_t *cursor;
+	mmarena_t *arena;
+	void *chunk;
+
+	if(len != state->chunk_len) {
+		return state->mem_alloc(len, state->alloc_p);
+	}
+
+	/* fill the oldest arenas first, so the newer ones get a chance to empty
+	   out and be unmapped */
+	DLIST_FOR_FWD(&(state->arena_list), cursor) {
+		arena = (mmarena_t *) cursor;
+		if(arena->free_list) {
+			chunk = arena->free_list;
+			arena->free_list = *(void **) chunk;
+			goto found;
+		}
+		if(arena->len - arena->carved >= len) {
+			chunk = arena->base + arena->carved;
+			arena->carved += len;
+			goto found;
+		}
+	}
+
+	arena = mmarena_new(state);
+	if(! arena) {
+		/* no address space for another arena: the chunk comes from the
+		   backing allocator instead, and mmarena_return() gives it back there
+		   as it lies in no arena */
+		return state->mem_alloc(len, state->alloc_p);
+	}
+	chunk = arena->base;
+	arena->carved = len;
+
+found:
+	arena->used++;
+	state->chunk_count++;
+	return chunk;
+}
+
+void mmarena_return(void *p, void *mmarena_state)
+{
+	mmarena_state_t *state = (mmarena_state_t *) mmarena_state;
+	mmarena_t *arena = mmarena_find(state, p);
+
+	if(! arena) {
+		state->mem_free(p, state->alloc_p);
+		return;
+	}
+
+	*(void **) p = arena->free_list;
+	arena->free_list = p;
+	arena->used--;
+	state->chunk_count--;
+	/* keep the last arena around so a heap hovering at an arena boundary
+	   does not keep mapping and unmapping it */
+	if(! arena->used && state->arena_count > 1) {
+		mmarena_release(state, arena);
+	}
+}
+
+uintptr_t mmarena_count_arenas(mmarena_state_t *state)
+{
+	return state->arena_count;
+}
+
+uintptr_t mmarena_count_chunks(mmarena_state_t *state)
+{
+	return state->chunk_count;
+}
@@ -0,0 +1,72 @@
+#if ! defined(MMAP_ARENA_H)
+#define MMAP_ARENA_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "dlist.h"
+
+#include "allocator_def.h"
+
+/* hands out fixed size chunks (e.g. GC slabs) carved from large mmap()ed
+   arenas; requests of any other length go to the backing allocator, as do
+   chunks when no new arena can be mapped */
+
+/* ask for transparent huge pages for the arenas (madvise(MADV_HUGEPAGE)),
+   where the platform has them */
+#define MMARENA_HUGEPAGE 0x1
+/* touch every page of a new arena up front instead of faulting it in on
+   first use */
+#define MMARENA_PREFAULT 0x2
+
+/* arenas are aligned to this, so they can be backed by huge pages */
+#define MMARENA_ALIGN (2 * 1024 * 1024)
+
+#if ! defined(MMARENA_DEFAULT_LEN)
+#define MMARENA_DEFAULT_LEN (32 * 1024 * 1024)
+#endif
+
+typedef struct {
+	dlnode_t hdr;
+	char *base;
+	size_t len;
+	size_t carved; /* bytes handed out from the start of the arena so far */
+	uintptr_t used; /* chunks currently handed out */
+	void *free_list; /* returned chunks, linked through their first word */
+} mmarena_t;
+
+typedef struct {
+	dlist_t arena_list;
+	size_t chunk_len;
+	size_t arena_len;
+	unsigned int flags;
+	mem_allocator_fn_t mem_alloc;
+	mem_free_fn_t mem_free;
+	void *alloc_p;
+	uintptr_t arena_count;
+	uintptr_t chunk_count;
+} mmarena_state_t;
+
+/* arena_len is rounded up to a multiple of MMARENA_ALIGN (0 picks
+   MMARENA_DEFAULT_LEN); chunk_len must be a multiple of the word size and no
+   larger than an arena */
+mmarena_state_t *mmarena_state_init(
+	void *p,
+	size_t chunk_len,
+	size_t arena_len,
+	unsigned int flags,
+	mem_allocator_fn_t mem_alloc,
+	mem_free_fn_t mem_free,
+	void *alloc_p);
+
+/* unmap every arena; chunks still handed out become invalid */
+void mmarena_state_reset(mmarena_state_t *state);
+
+void *mmarena_request(size_t len, void *mmarena_state);
+void mmarena_return(void *p, void *mmarena_state);
+
+/* arenas currently mapped, chunks currently handed out from them */
+uintptr_t mmarena_count_arenas(mmarena_state_t *state);
+uintptr_t mmarena_count_chunks(mmarena_state_t *state);
+
+#endif
@@ -4,6 +4,7 @@
 
 #include "dlist.h"
 #include "node.h"
+#include "node_links.h"
 #include "memory.h"
 #include "libc_custom.h"
 #include "stream.h"
@@ -42,21 +43,30 @@ static void links_cb(void (*cb)(void *link, void *p), void *data, void *p)
 		}
 	});
 
+	NODE_FOR_EACH_LINK(n, cb, p);
+}
+
+/* rewrites the links links_cb() reports, and weak handle links */
+static void relocate_cb(void *(*fix)(void *link, void *p), void *data, void *p)
+{
+	node_t *n = (node_t *) data;
+
 	switch(node_type(n)) {
 	case NODE_CONS:
-		cb(n->dat.cons.car, p);
-		cb(n->dat.cons.cdr, p);
+		n->dat.cons.car = node_ref(fix(node_deref(n, n->dat.cons.car), p));
+		n->dat.cons.cdr = node_ref(fix(node_deref(n, n->dat.cons.cdr), p));
 		break;
 	case NODE_LAMBDA:
-		cb(n->dat.lambda.env, p);
-		cb(n->dat.lambda.vars, p);
-		cb(n->dat.lambda.expr, p);
+		n->dat.lambda.env =
+			node_ref(fix(node_deref(n, n->dat.lambda.env), p));
+		n->dat.lambda.body =
+			node_ref(fix(node_deref(n, n->dat.lambda.body), p));
 		break;
 	case NODE_HANDLE:
-		cb(n->dat.handle.link, p);
-		break;
 	case NODE_CONTINUATION:
-		cb(n->dat.handle.link, p);
+	case NODE_WEAK_HANDLE:
+		n->dat.handle.link =
+			node_ref(fix(node_deref(n, n->dat.handle.link), p));
 		break;
 	default:
 		break;
@@ -72,7 +82,7 @@ static void node_print_wrap(void *p, stream_t *stream)
 static void node_init_cb(void *p)
 {
 	node_t *n = (node_t *) p;
-	bzero_custom(n, sizeof(*n));
+	/* node_new clears the rest, it knows how large the node is */
 	n->type = NODE_UNINITIALIZED;
 }
 
@@ -85,10 +95,14 @@ memory_state_t *node_memstate_init(
 	memory_state_init(s,
 	                  node_init_cb,
 	                  links_cb,
+	                  relocate_cb,
 	                  node_print_wrap,
 	                  allocfn,
 	                  freefn,
 	                  alloc_priv);
+#if defined(NODE_NO_INCREMENTAL_GC)
+	memory_gc_set_pace(s, 0);
+#endif
 	return s;
 }
 
@@ -97,24 +111,34 @@ memory_state_t *node_memstate(node_t *n)
 	return data_to_memstate(n);
 }
 
-#if defined(NODE_NO_INCREMENTAL_GC)
-	#define NODE_GC_ITERATE(STATE)
-#else
-	#if defined(NODE_INCREMENTAL_FULL_GC)
+/* GC work is paced by memory_request(), so reading nodes never runs the GC.
+   NODE_INCREMENTAL_FULL_GC additionally collects everything after each
+   allocation and mutation, to shake out missing links and locks, except in
+   a finalizer run by the GC. */
+#if defined(NODE_INCREMENTAL_FULL_GC)
+	/* STATE is evaluated once: the first cycle may free the node it was
+	   derived from */
 	#define NODE_GC_ITERATE(STATE) \
 		do { \
-			memory_gc_cycle(STATE); \
-			memory_gc_cycle(STATE); \
+			memory_state_t *gc_state_ = (STATE); \
+			if(! memory_gc_active(gc_state_)) { \
+				memory_gc_cycle(gc_state_); \
+				memory_gc_cycle(gc_state_); \
+			} \
 		} while(0)
-	#else
-	#define NODE_GC_ITERATE(STATE) memory_gc_iterate(STATE)
-	#endif
+#else
+	#define NODE_GC_ITERATE(STATE) do { } while(0)
 #endif
 
-static node_t *node_new(memory_state_t *s)
+/* bytes needed by a node using the given member of dat */
+#define NODE_SIZE(MEMBER) \
+	(offsetof(node_t, dat) + sizeof(((node_t *) 0)->dat.MEMBER))
+
+static node_t *node_new(memory_state_t *s, size_t size)
 {
 	node_t *n;
-	n = memory_request(s, sizeof(node_t));
+	n = memory_request(s, size);
+	bzero_custom(&(n->dat), size - offsetof(node_t, dat));
 	return n;
 }
 
@@ -148,8 +172,8 @@ static void node_droproot_int(node_t *n)
 
 void node_droproot(node_t *n)
 {
+	/* no GC step: n may be freed by it, and the next allocation runs one */
 	node_droproot_int(n);
-	NODE_GC_ITERATE(data_to_memstate(n));
 }
 
 node_t *node_lockroot(node_t *n)
@@ -163,22 +187,36 @@ node_t *node_lockroot(node_t *n)
 
 bool node_isroot(node_t *n)
 {
-	NODE_GC_ITERATE(data_to_memstate(n));
 	return memory_gc_isroot(data_to_memstate(n), n);
 }
 
 bool node_islocked(node_t *n)
 {
-	NODE_GC_ITERATE(data_to_memstate(n));
 	return memory_gc_is_locked(n);
 }
 
+void node_roots_push(memory_state_t *s, node_t **slots, size_t n)
+{
+	memory_gc_roots_push(s, (void **) slots, n);
+}
+
+void node_roots_pop(memory_state_t *s, node_t **slots, size_t n)
+{
+	memory_gc_roots_pop(s, (void **) slots, n);
+}
+
+void node_root_set(memory_state_t *s, node_t **slot, node_t *n)
+{
+	memory_gc_root_set(s, (void **) slot, n);
+	NODE_GC_ITERATE(s);
+}
+
 node_t *node_cons_new(memory_state_t *s, node_t *car, node_t *cdr)
 {
-	node_t *ret = node_new(s);
+	node_t *ret = node_new(s, NODE_SIZE(cons));
 	assert(ret);
-	ret->dat.cons.car = node_retain(car);
-	ret->dat.cons.cdr = node_retain(cdr);
+	ret->dat.cons.car = node_ref(node_retain(car));
+	ret->dat.cons.cdr = node_ref(node_retain(cdr));
 	ret->type = NODE_CONS;
 	DBGTRACE(TC_NODE_INIT, "node init: ");
 	DBGRUN(TC_NODE_INIT, { node_print_stream(dbgtrace_getstream(), ret); });
@@ -195,8 +233,10 @@ void node_cons_patch_car(node_t *n, node_t *newcar)
 	assert(n);
 	assert(n->type == NODE_CONS);
 
-	oldcar = n->dat.cons.car;
-	n->dat.cons.car = node_retain(newcar);
+	oldcar = node_deref(n, n->dat.cons.car);
+	memory_gc_overwrite_barrier(data_to_memstate(n), oldcar);
+	NODE_LINK_STORE(n->dat.cons.car, node_ref(node_retain(newcar)));
+	memory_gc_write_barrier(data_to_memstate(n), n, newcar);
 
 	node_release(oldcar);
 	NODE_GC_ITERATE(data_to_memstate(n));
@@ -209,8 +249,10 @@ void node_cons_patch_cdr(node_t *n, node_t *newcdr)
 	assert(n);
 	assert(n->type == NODE_CONS);
 
-	oldcdr = n->dat.cons.cdr;
-	n->dat.cons.cdr = node_retain(newcdr);
+	oldcdr = node_deref(n, n->dat.cons.cdr);
+	memory_gc_overwrite_barrier(data_to_memstate(n), oldcdr);
+	NODE_LINK_STORE(n->dat.cons.cdr, node_ref(node_retain(newcdr)));
+	memory_gc_write_barrier(data_to_memstate(n), n, newcdr);
 
 	node_release(oldcdr);
 	NODE_GC_ITERATE(data_to_memstate(n));
@@ -221,8 +263,7 @@ node_t *node_cons_car(node_t *n)
 	node_t *ret = NULL;
 	if(n) {
 		assert(n->type == NODE_CONS);
-		ret = n->dat.cons.car;
-		NODE_GC_ITERATE(data_to_memstate(n));
+		ret = node_deref(n, n->dat.cons.car);
 	}
 	return ret;
 }
@@ -232,53 +273,61 @@ node_t *node_cons_cdr(node_t *n)
 	node_t *ret = NULL;
 	if(n) {
 		assert(n->type == NODE_CONS);
-		ret = n->dat.cons.cdr;
-		NODE_GC_ITERATE(data_to_memstate(n));
+		ret = node_deref(n, n->dat.cons.cdr);
 	}
 	return ret;
 }
 
-node_t *node_lambda_new(memory_state_t *s, node_t *env, node_t *vars, node_t *expr)
+node_t *node_lambda_new(memory_state_t *s, node_t *env, node_t *body)
 {
-	node_t *ret = node_new(s);
+	node_t *ret = node_new(s, NODE_SIZE(lambda));
 	assert(ret);
-	ret->dat.lambda.env = node_retain(env);
-	ret->dat.lambda.vars = node_retain(vars);
-	ret->dat.lambda.expr = node_retain(expr);
+	assert(node_type(body) == NODE_CONS);
+	ret->dat.lambda.env = node_ref(node_retain(env));
+	ret->dat.lambda.body = node_ref(node_retain(body));
 	ret->type = NODE_LAMBDA;
 	DBGTRACE(TC_NODE_INIT, "node init: ");
 	DBGRUN(TC_NODE_INIT, { node_print_stream(dbgtrace_getstream(), ret); });
 	NODE_GC_ITERATE(s);
 	if(env) NODE_GC_ITERATE(data_to_memstate(env));
-	if(vars) NODE_GC_ITERATE(data_to_memstate(vars));
-	if(expr) NODE_GC_ITERATE(data_to_memstate(expr));
+	NODE_GC_ITERATE(data_to_memstate(body));
 	return ret;
 }
 
+/* vars and expr are the car and cdr of the lambda body */
+static node_t *lambda_vars(node_t *n)
+{
+	node_t *body = node_deref(n, n->dat.lambda.body);
+	return node_deref(body, body->dat.cons.car);
+}
+
+static node_t *lambda_expr(node_t *n)
+{
+	node_t *body = node_deref(n, n->dat.lambda.body);
+	return node_deref(body, body->dat.cons.cdr);
+}
+
 node_t *node_lambda_env(node_t *n)
 {
-	assert(n->type = NODE_LAMBDA);
-	NODE_GC_ITERATE(data_to_memstate(n));
-	return n->dat.lambda.env;
+	assert(n->type == NODE_LAMBDA);
+	return node_deref(n, n->dat.lambda.env);
 }
 
 node_t *node_lambda_vars(node_t *n)
 {
-	assert(n->type = NODE_LAMBDA);
-	NODE_GC_ITERATE(data_to_memstate(n));
-	return n->dat.lambda.vars;
+	assert(n->type == NODE_LAMBDA);
+	return lambda_vars(n);
 }
 
 node_t *node_lambda_expr(node_t *n)
 {
-	assert(n->type = NODE_LAMBDA);
-	NODE_GC_ITERATE(data_to_memstate(n));
-	return n->dat.lambda.expr;
+	assert(n->type == NODE_LAMBDA);
+	return lambda_expr(n);
 }
 
 node_t *node_value_new(memory_state_t *s, value_t val)
 {
-	node_t *ret = node_new(s);
+	node_t *ret = node_new(s, NODE_SIZE(value));
 	assert(ret);
 	ret->dat.value = val;
 	ret->type = NODE_VALUE;
@@ -291,15 +340,19 @@ node_t *node_value_new(memory_state_t *s, value_t val)
 value_t node_value(node_t *n)
 {
 	assert(n->type == NODE_VALUE);
-	NODE_GC_ITERATE(data_to_memstate(n));
 	return n->dat.value;
 }
 
 node_t *node_symbol_new(memory_state_t *s, char *name)
 {
-	node_t *ret = node_new(s);
+	node_t *ret;
+	size_t len;
+
+	/* names longer than MAX_SYM_LEN - 1 are truncated */
+	for(len = 0; len < MAX_SYM_LEN - 1 && name[len]; len++);
+	ret = node_new(s, offsetof(node_t, dat.name) + len + 1);
 	assert(ret);
-	strncpy_custom(ret->dat.name, name, sizeof(ret->dat.name));
+	strncpy_custom(ret->dat.name, name, len);
 	ret->type = NODE_SYMBOL;
 	DBGTRACE(TC_NODE_INIT, "node init: ");
 	DBGRUN(TC_NODE_INIT, { node_print_stream(dbgtrace_getstream(), ret); });
@@ -310,13 +363,12 @@ node_t *node_symbol_new(memory_state_t *s, char *name)
 char *node_symbol_name(node_t *n)
 {
 	assert(n->type == NODE_SYMBOL);
-	NODE_GC_ITERATE(data_to_memstate(n));
 	return n->dat.name;
 }
 
 node_t *node_foreign_new(memory_state_t *s, foreign_t func)
 {
-	node_t *ret = node_new(s);
+	node_t *ret = node_new(s, NODE_SIZE(func));
 	assert(ret);
 	ret->dat.func = func;
 	ret->type = NODE_FOREIGN;
@@ -329,16 +381,15 @@ node_t *node_foreign_new(memory_state_t *s, foreign_t func)
 foreign_t node_foreign_func(node_t *n)
 {
 	assert(n->type == NODE_FOREIGN);
-	NODE_GC_ITERATE(data_to_memstate(n));
 	return n->dat.func;
 }
 
 node_t *node_handle_new(memory_state_t *s, node_t *link)
 {
-	node_t *ret = node_new(s);
+	node_t *ret = node_new(s, NODE_SIZE(handle));
 	assert(ret);
 	ret->type = NODE_HANDLE;
-	ret->dat.handle.link = node_retain(link);
+	ret->dat.handle.link = node_ref(node_retain(link));
 	DBGTRACE(TC_NODE_INIT, "node init: ");
 	DBGRUN(TC_NODE_INIT, { node_print_stream(dbgtrace_getstream(), ret); });
 	NODE_GC_ITERATE(s);
@@ -349,8 +400,7 @@ node_t *node_handle_new(memory_state_t *s, node_t *link)
 node_t *node_handle(node_t *n)
 {
 	assert(node_type(n) == NODE_HANDLE);
-	NODE_GC_ITERATE(data_to_memstate(n));
-	return n->dat.handle.link;
+	return node_deref(n, n->dat.handle.link);
 }
 
 void node_handle_update(node_t *n, node_t *newlink)
@@ -358,20 +408,53 @@ void node_handle_update(node_t *n, node_t *newlink)
 	node_t *oldlink;
 	assert(node_type(n) == NODE_HANDLE);
 
-	oldlink = n->dat.handle.link;
-	n->dat.handle.link = node_retain(newlink);
+	oldlink = node_deref(n, n->dat.handle.link);
+	memory_gc_overwrite_barrier(data_to_memstate(n), oldlink);
+	NODE_LINK_STORE(n->dat.handle.link, node_ref(node_retain(newlink)));
+	memory_gc_write_barrier(data_to_memstate(n), n, newlink);
 
 	node_release(oldlink);
 	NODE_GC_ITERATE(data_to_memstate(n));
 	if(newlink) NODE_GC_ITERATE(data_to_memstate(newlink));
 }
 
+node_t *node_weak_handle_new(memory_state_t *s, node_t *link)
+{
+	node_t *ret = node_new(s, NODE_SIZE(handle));
+	assert(ret);
+	ret->type = NODE_WEAK_HANDLE;
+	ret->dat.handle.link = node_ref(link);
+	memory_gc_weak_link(s, ret, link);
+	DBGTRACE(TC_NODE_INIT, "node init: ");
+	DBGRUN(TC_NODE_INIT, { node_print_stream(dbgtrace_getstream(), ret); });
+	NODE_GC_ITERATE(s);
+	return ret;
+}
+
+node_t *node_weak_handle(node_t *n)
+{
+	assert(node_type(n) == NODE_WEAK_HANDLE);
+	return memory_gc_weak_get(data_to_memstate(n),
+	                          node_deref(n, n->dat.handle.link));
+}
+
+void node_weak_handle_update(node_t *n, node_t *newlink)
+{
+	memory_state_t *s = data_to_memstate(n);
+	assert(node_type(n) == NODE_WEAK_HANDLE);
+
+	memory_gc_weak_unlink(s, n, node_deref(n, n->dat.handle.link));
+	n->dat.handle.link = node_ref(newlink);
+	memory_gc_weak_link(s, n, newlink);
+	NODE_GC_ITERATE(s);
+}
+
 node_t *node_cont_new(memory_state_t *s, node_t *bt)
 {
-	node_t *ret = node_new(s);
+	node_t *ret = node_new(s, NODE_SIZE(cont));
 	assert(ret);
 	ret->type = NODE_CONTINUATION;
-	ret->dat.cont.bt = node_retain(bt);
+	ret->dat.cont.bt = node_ref(node_retain(bt));
 	DBGTRACE(TC_NODE_INIT, "node init: ");
 	DBGRUN(TC_NODE_INIT, { node_print_stream(dbgtrace_getstream(), ret); });
 	NODE_GC_ITERATE(s);
@@ -382,13 +465,12 @@ node_t *node_cont_new(memory_state_t *s, node_t *bt)
 node_t *node_cont(node_t *n)
 {
 	assert(node_type(n) == NODE_CONTINUATION);
-	NODE_GC_ITERATE(data_to_memstate(n));
-	return n->dat.cont.bt;
+	return node_deref(n, n->dat.cont.bt);
 }
 
 node_t *node_special_func_new(memory_state_t *s, special_func_t func)
 {
-	node_t *ret = node_new(s);
+	node_t *ret = node_new(s, NODE_SIZE(special));
 	assert(ret);
 	ret->type = NODE_SPECIAL_FUNC;
 	ret->dat.special = func; 
@@ -402,7 +484,6 @@ node_t *node_special_func_new(memory_state_t *s, special_func_t func)
 special_func_t node_special_func(node_t *n)
 {
 	assert(node_type(n) == NODE_SPECIAL_FUNC);
-	NODE_GC_ITERATE(data_to_memstate(n));
 	return n->dat.special;
 }
 
@@ -413,13 +494,20 @@ static void blob_fin_wrap(void *data)
 	if(n->dat.blob.fin) {
 		n->dat.blob.fin(n->dat.blob.addr);
 	}
+	if(n->dat.blob.len) {
+		memory_large_return(data_to_memstate(n), n->dat.blob.addr);
+	}
 }
 
 node_t *node_blob_new(memory_state_t *s, void *addr, blob_fin_t fin, uintptr_t sig)
 {
-	node_t *ret = node_new(s);
+	node_t *ret = node_new(s, NODE_SIZE(blob));
 	assert(ret);
-	memory_set_finalizer(ret, blob_fin_wrap);
+	/* only blobs with a finalizer of their own are finalizable. Nodes only
+	   ever register blob_fin_wrap, so there is always room for it. */
+	if(fin) {
+		memory_set_finalizer(ret, blob_fin_wrap);
+	}
 	ret->type = NODE_BLOB;
 	ret->dat.blob.addr = addr; 
 	ret->dat.blob.fin = fin;
@@ -430,20 +518,50 @@ node_t *node_blob_new(memory_state_t *s, void *addr, blob_fin_t fin, uintptr_t s
 	return ret;
 }
 
+node_t *node_blob_alloc(memory_state_t *s,
+                        size_t len, blob_fin_t fin, uintptr_t sig)
+{
+	void *addr;
+	node_t *ret;
+
+	assert(len);
+	addr = memory_large_request(s, len);
+	if(! addr) {
+		return NULL;
+	}
+	ret = node_new(s, NODE_SIZE(blob));
+	assert(ret);
+	/* as in node_blob_new(), there is always room for blob_fin_wrap */
+	memory_set_finalizer(ret, blob_fin_wrap);
+	ret->type = NODE_BLOB;
+	ret->dat.blob.addr = addr;
+	ret->dat.blob.fin = fin;
+	ret->dat.blob.sig = sig;
+	ret->dat.blob.len = len;
+	DBGTRACE(TC_NODE_INIT, "node init: ");
+	DBGRUN(TC_NODE_INIT, { node_print_stream(dbgtrace_getstream(), ret); });
+	NODE_GC_ITERATE(s);
+	return ret;
+}
+
 void *node_blob_addr(node_t *n)
 {
 	assert(node_type(n) == NODE_BLOB);
-	NODE_GC_ITERATE(data_to_memstate(n));
 	return n->dat.blob.addr;
 }
 
 uintptr_t node_blob_sig(node_t *n)
 {
 	assert(node_type(n) == NODE_BLOB);
-	NODE_GC_ITERATE(data_to_memstate(n));
 	return n->dat.blob.sig;
 }
 
+size_t node_blob_len(node_t *n)
+{
+	assert(node_type(n) == NODE_BLOB);
+	return n->dat.blob.len;
+}
+
 void node_print_stream(stream_t *s, node_t *n)
 {
 	char buf[21], buf2[21], buf3[21];
@@ -460,14 +578,19 @@ void node_print_stream(stream_t *s, node_t *n)
 			stream_putstr(s, "uninitialized");
 			break;
 		case NODE_CONS:
-			stream_put(s, "cons car=", fmt_ptr(buf, n->dat.cons.car),
-			              " cdr=", fmt_ptr(buf2, n->dat.cons.cdr),
+			stream_put(s, "cons ",
+			              "car=",
+			              fmt_ptr(buf, node_deref(n, n->dat.cons.car)),
+			              " cdr=",
+			              fmt_ptr(buf2, node_deref(n, n->dat.cons.cdr)),
 			              NULL);
 			break;
 		case NODE_LAMBDA:
-			stream_put(s, "lam env=", fmt_ptr(buf, n->dat.lambda.env),
-			              " vars=", fmt_ptr(buf2, n->dat.lambda.vars),
-			              " expr=", fmt_ptr(buf3, n->dat.lambda.expr),
+			stream_put(s, "lam ",
+			              "env=",
+			              fmt_ptr(buf, node_deref(n, n->dat.lambda.env)),
+			              " body=",
+			              fmt_ptr(buf2, node_deref(n, n->dat.lambda.body)),
 			              NULL);
 			break;
 		case NODE_SYMBOL:
@@ -480,11 +603,13 @@ void node_print_stream(stream_t *s, node_t *n)
 			stream_put(s, "foreign ", fmt_ptr(buf, n->dat.func), NULL);
 			break;
 		case NODE_HANDLE:
-			stream_put(s, "handle lnk=", fmt_ptr(buf, n->dat.handle.link), 
+			stream_put(s, "handle lnk=",
+			              fmt_ptr(buf, node_deref(n, n->dat.handle.link)),
 			                   NULL);
 			break;
 		case NODE_CONTINUATION:
-			stream_put(s, "cont bt=", fmt_ptr(buf, n->dat.cont.bt), NULL);
+			stream_put(s, "cont bt=",
+			              fmt_ptr(buf, node_deref(n, n->dat.cont.bt)), NULL);
 			break;
 		case NODE_SPECIAL_FUNC:
 			stream_put(s, "special ", fmt_s64(buf, n->dat.special), NULL);
@@ -494,6 +619,14 @@ void node_print_stream(stream_t *s, node_t *n)
 			              " fin=", fmt_ptr(buf2, n->dat.blob.fin),
 			              " sig=", fmt_ptr(buf3, (void*) n->dat.blob.sig),
 			              NULL);
+			if(n->dat.blob.len) {
+				stream_put(s, " len=", fmt_u64d(buf, n->dat.blob.len), NULL);
+			}
+			break;
+		case NODE_WEAK_HANDLE:
+			stream_put(s, "weak lnk=",
+			              fmt_ptr(buf, node_deref(n, n->dat.handle.link)),
+			              NULL);
 			break;
 		}
 	}
@@ -508,30 +641,27 @@ void node_print_recursive_stream(stream_t *s, node_t *n)
 	}
 	if(n->type == NODE_CONS) {
 		if(n->dat.cons.car)
-			node_print_recursive_stream(s, n->dat.cons.car);
+			node_print_recursive_stream(s, node_deref(n, n->dat.cons.car));
 		if(n->dat.cons.cdr)
-			node_print_recursive_stream(s, n->dat.cons.cdr);
+			node_print_recursive_stream(s, node_deref(n, n->dat.cons.cdr));
 	} else if(n->type == NODE_LAMBDA) {
     	if(n->dat.lambda.env)
-			node_print_stream(s, n->dat.lambda.env);
-		if(n->dat.lambda.vars)
-			node_print_recursive_stream(s, n->dat.lambda.vars);
-		if(n->dat.lambda.expr)
-			node_print_recursive_stream(s, n->dat.lambda.expr);
+			node_print_stream(s, node_deref(n, n->dat.lambda.env));
+		node_print_recursive_stream(s, node_deref(n, n->dat.lambda.body));
 	} else if(n->type == NODE_HANDLE) {
     	if(n->dat.handle.link)
-			node_print_recursive_stream(s, n->dat.handle.link);
+			node_print_recursive_stream(s, node_deref(n, n->dat.handle.link));
 	} else if(n->type == NODE_CONTINUATION) {
     	if(n->dat.cont.bt)
-			node_print_recursive_stream(s, n->dat.cont.bt);
+			node_print_recursive_stream(s, node_deref(n, n->dat.cont.bt));
 	}
 }
 
 static void node_print_list_shorthand_stream(stream_t *s,node_t *n)
 {
 	if(node_type(n) == NODE_CONS) {
-		node_print_pretty_stream(s, n->dat.cons.car, false);
-		node_print_list_shorthand_stream(s, n->dat.cons.cdr);
+		node_print_pretty_stream(s, node_deref(n, n->dat.cons.car), false);
+		node_print_list_shorthand_stream(s, node_deref(n, n->dat.cons.cdr));
 	} else if(n == NULL) {
 
 	} else {
@@ -543,6 +673,7 @@ static void node_print_list_shorthand_stream(stream_t *s,node_t *n)
 void node_print_pretty_stream(stream_t *s, node_t *n, bool isverbose)
 {
 	char buf[21];
+	node_t *cdr;
 
 	switch(node_type(n)) {
 	case NODE_UNINITIALIZED:
@@ -552,38 +683,39 @@ void node_print_pretty_stream(stream_t *s, node_t *n, bool isverbose)
 		stream_putstr(s, "() ");
 		break;
 	case NODE_CONS:
+		cdr = node_deref(n, n->dat.cons.cdr);
 		stream_putstr(s, "( ");
-		node_print_pretty_stream(s, n->dat.cons.car, isverbose);
+		node_print_pretty_stream(s, node_deref(n, n->dat.cons.car), isverbose);
 		if(isverbose) {
 			stream_putstr(s, ". ");
 			node_print_pretty_stream(s, node_cons_cdr(n), true);
-		} else if(node_type(n->dat.cons.cdr) == NODE_CONS ||
-		          node_type(n->dat.cons.cdr) == NODE_NIL ||
-		          node_type(n->dat.cons.cdr) == NODE_LAMBDA){
-			node_print_list_shorthand_stream(s, n->dat.cons.cdr);
+		} else if(node_type(cdr) == NODE_CONS ||
+		          node_type(cdr) == NODE_NIL ||
+		          node_type(cdr) == NODE_LAMBDA){
+			node_print_list_shorthand_stream(s, cdr);
 		} else {
 			stream_putstr(s, ". ");
-			node_print_pretty_stream(s, n->dat.cons.cdr, false);
+			node_print_pretty_stream(s, cdr, false);
 		}
 		stream_putstr(s, ") ");
 		break;
 	case NODE_LAMBDA:
 		if(isverbose) {
 			stream_putstr(s, "( lambda . ( ");
-			node_print_pretty_stream(s, n->dat.lambda.vars, true);
+			node_print_pretty_stream(s, lambda_vars(n), true);
 			stream_putstr(s, " . ");
-			node_print_pretty_stream(s, n->dat.lambda.expr, true);
+			node_print_pretty_stream(s, lambda_expr(n), true);
 			stream_putstr(s, ") ) ");
-		} else if(node_type(n->dat.lambda.vars) == NODE_SYMBOL){
+		} else if(node_type(lambda_vars(n)) == NODE_SYMBOL){
 			stream_putstr(s, "( lambda ");
-			node_print_pretty_stream(s, n->dat.lambda.vars, false);
-			node_print_list_shorthand_stream(s, n->dat.lambda.expr);
+			node_print_pretty_stream(s, lambda_vars(n), false);
+			node_print_list_shorthand_stream(s, lambda_expr(n));
 			stream_putstr(s, ") ");
 		} else {
 			stream_putstr(s, "( lambda ( ");
-			node_print_list_shorthand_stream(s, n->dat.lambda.vars);
+			node_print_list_shorthand_stream(s, lambda_vars(n));
 			stream_putstr(s, ") ");
-			node_print_list_shorthand_stream(s, n->dat.lambda.expr);
+			node_print_list_shorthand_stream(s, lambda_expr(n));
 			stream_putstr(s, ") ");
 		}
 		break;
@@ -598,7 +730,7 @@ void node_print_pretty_stream(stream_t *s, node_t *n, bool isverbose)
 		break;
 	case NODE_HANDLE:
 		stream_putstr(s, "& ");
-		node_print_pretty_stream(s, n->dat.handle.link, isverbose);
+		node_print_pretty_stream(s, node_deref(n, n->dat.handle.link), isverbose);
 		break;
 	case NODE_CONTINUATION:
 		stream_putstr(s, "@ ");
@@ -633,5 +765,9 @@ void node_print_pretty_stream(stream_t *s, node_t *n, bool isverbose)
 	case NODE_BLOB:
 		stream_put(s, "blob:", fmt_ptr(buf, n->dat.blob.addr), " ", NULL);
 		break;
+	case NODE_WEAK_HANDLE:
+		stream_putstr(s, "~ ");
+		node_print_pretty_stream(s, node_weak_handle(n), isverbose);
+		break;
 	}
 }
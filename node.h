@@ -19,7 +19,8 @@ X(NODE_FOREIGN) \
 X(NODE_HANDLE) \
 X(NODE_CONTINUATION) \
 X(NODE_SPECIAL_FUNC) \
-X(NODE_BLOB)
+X(NODE_BLOB) \
+X(NODE_WEAK_HANDLE)
 
 typedef enum {
 #define X(name) name,
@@ -58,17 +59,36 @@ typedef uint64_t u_value_t;
 
 typedef void (*blob_fin_t)(void *addr);
 
+/* links between nodes. With NODE_COMPRESSED_REFS they are stored as 32-bit
+   memory_ref_t and must be decoded through node_deref() in node.c */
+#if defined(NODE_COMPRESSED_REFS)
+#if defined(NO_GC_FREELIST)
+#error NODE_COMPRESSED_REFS cannot be used with NO_GC_FREELIST
+#endif
+#if defined(GC_CONCURRENT_MARK)
+/* the marker thread would race the mutator growing the slab table */
+#error NODE_COMPRESSED_REFS cannot be used with GC_CONCURRENT_MARK
+#endif
+typedef memory_ref_t node_ref_t;
+#else
+typedef node_t *node_ref_t;
+#endif
+
+/* nodes are only allocated as large as their type's member of dat. Symbol
+   names are sized to fit, and a lambda keeps (vars . expr) as a cons. */
 struct node {
 	nodetype_t type;
 	union {
-		struct { node_t *car, *cdr; } cons;
-		struct { node_t *env, *vars, *expr; } lambda;
+		struct { node_ref_t car, cdr; } cons;
+		struct { node_ref_t env, body; } lambda;
 		foreign_t func;
 		char name[MAX_SYM_LEN];
 		value_t value;
-		struct { node_t *link; } handle;
-		struct { node_t *bt; } cont;
-		struct { void *addr; blob_fin_t fin; uintptr_t sig; } blob;
+		struct { node_ref_t link; } handle;
+		struct { node_ref_t bt; } cont;
+		/* len is that of an allocated payload, 0 for an external addr */
+		struct { void *addr; blob_fin_t fin; uintptr_t sig;
+		         size_t len; } blob;
 		special_func_t special;
 	} dat;
 };
@@ -87,6 +107,12 @@ void node_droproot(node_t *n); /* -> (unlocked, not root) */
 bool node_isroot(node_t *n);
 node_t *node_lockroot(node_t *n); /* -> (locked, root) */
 bool node_islocked(node_t *n);
+/* shadow stack roots (see memory_gc_roots_push()): n consecutive slots, on
+   the C stack say, that keep the nodes they link to alive until popped.
+   Write them through node_root_set() only. */
+void node_roots_push(memory_state_t *s, node_t **slots, size_t n);
+void node_roots_pop(memory_state_t *s, node_t **slots, size_t n);
+void node_root_set(memory_state_t *s, node_t **slot, node_t *n);
 
 node_t *node_cons_new(memory_state_t *s, node_t *car, node_t *cdr);
 node_t *node_cons_car(node_t *n);
@@ -94,7 +120,8 @@ node_t *node_cons_cdr(node_t *n);
 void node_cons_patch_car(node_t *n, node_t *newcar);
 void node_cons_patch_cdr(node_t *n, node_t *newcdr);
 
-node_t *node_lambda_new(memory_state_t *s, node_t *env, node_t *vars, node_t *expr);
+/* body is the cons (vars . expr) */
+node_t *node_lambda_new(memory_state_t *s, node_t *env, node_t *body);
 node_t *node_lambda_env(node_t *n);
 node_t *node_lambda_vars(node_t *n);
 node_t *node_lambda_expr(node_t *n);
@@ -115,6 +142,12 @@ node_t *node_handle_new(memory_state_t *s, node_t *link);
 node_t *node_handle(node_t *n);
 void node_handle_update(node_t *n, node_t *newlink);
 
+/* a weak handle does not keep its link alive: it reads as NULL once the GC
+   has found the link unreachable */
+node_t *node_weak_handle_new(memory_state_t *s, node_t *link);
+node_t *node_weak_handle(node_t *n);
+void node_weak_handle_update(node_t *n, node_t *newlink);
+
 node_t *node_cont_new(memory_state_t *s, node_t *bt);
 node_t *node_cont(node_t *n);
 
@@ -123,8 +156,15 @@ special_func_t node_special_func(node_t *n);
 
 node_t *node_blob_new(memory_state_t *s,
                       void *addr, blob_fin_t fin, uintptr_t sig);
+/* a blob with a payload of len bytes (> 0) allocated from the large object
+   space, which counts toward the heap. fin (may be NULL) runs on the payload
+   before it is returned. NULL if the payload cannot be mapped. */
+node_t *node_blob_alloc(memory_state_t *s,
+                        size_t len, blob_fin_t fin, uintptr_t sig);
 void *node_blob_addr(node_t *n);
 uintptr_t node_blob_sig(node_t *n);
+/* payload length, 0 for a blob made by node_blob_new() */
+size_t node_blob_len(node_t *n);
 
 void node_print_stream(stream_t *s, node_t *n);
 void node_print_recursive_stream(stream_t *s, node_t *n);
@@ -0,0 +1,69 @@
+#if ! defined(NODE_LINKS_H)
+#define NODE_LINKS_H
+
+#include "node.h"
+#include "memory.h"
+
+/* the links between nodes, for node.c and for memory.c built with
+   GC_INLINE_LINKS, which traces nodes without going through the data link
+   callback */
+
+#if defined(NODE_COMPRESSED_REFS)
+/* links are decoded relative to the memory state of the node holding them */
+static inline node_t *node_deref(node_t *from, node_ref_t ref)
+{
+	return memory_ref_to_data(data_to_memstate(from), ref);
+}
+
+static inline node_ref_t node_ref(node_t *n)
+{
+	return memory_data_to_ref(n);
+}
+#else
+static inline node_t *node_deref(node_t *from, node_ref_t ref)
+{
+	(void) from;
+	return ref;
+}
+
+static inline node_ref_t node_ref(node_t *n)
+{
+	return n;
+}
+#endif
+
+/* the marker thread of GC_CONCURRENT_MARK reads links while the mutator
+   patches them, so both sides load and store them atomically there */
+#if defined(GC_CONCURRENT_MARK)
+#define NODE_LINK_LOAD(LINK) __atomic_load_n(&(LINK), __ATOMIC_RELAXED)
+#define NODE_LINK_STORE(LINK, VAL) \
+	__atomic_store_n(&(LINK), (VAL), __ATOMIC_RELAXED)
+#else
+#define NODE_LINK_LOAD(LINK) (LINK)
+#define NODE_LINK_STORE(LINK, VAL) ((LINK) = (VAL))
+#endif /* defined(GC_CONCURRENT_MARK) */
+
+/* call CB(link, P) for every link the node at DATA holds. CB is called by
+   name, so it is inlined where the compiler sees fit. */
+#define NODE_FOR_EACH_LINK(DATA, CB, P) \
+	do { \
+		node_t *n_ = (node_t *) (DATA); \
+		switch(n_->type) { \
+		case NODE_CONS: \
+			CB(node_deref(n_, NODE_LINK_LOAD(n_->dat.cons.car)), (P)); \
+			CB(node_deref(n_, NODE_LINK_LOAD(n_->dat.cons.cdr)), (P)); \
+			break; \
+		case NODE_LAMBDA: \
+			CB(node_deref(n_, NODE_LINK_LOAD(n_->dat.lambda.env)), (P)); \
+			CB(node_deref(n_, NODE_LINK_LOAD(n_->dat.lambda.body)), (P)); \
+			break; \
+		case NODE_HANDLE: \
+		case NODE_CONTINUATION: \
+			CB(node_deref(n_, NODE_LINK_LOAD(n_->dat.handle.link)), (P)); \
+			break; \
+		default: \
+			break; \
+		} \
+	} while(0)
+
+#endif
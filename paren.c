@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <errno.h>
 #include <string.h>
 
@@ -11,6 +12,7 @@
 #include "fdstream.h"
 #include "dbgtrace.h"
 #include "malloc_wrapper.h"
+#include "mmap_arena.h"
 
 #define DEFINE_SPECIAL_MAKER(FUNC) \
 static node_t *make_special_ ## FUNC (memory_state_t *ms) \
@@ -38,6 +40,21 @@ foreign_assoc_t startenv[] = {
 	{ "eval",     make_special_EVAL },
 };
 
+/* PAREN_SLAB_FAIL=N: every GC slab request past the first N fails, as if
+   the system ran out of memory */
+static unsigned long slab_fail_after;
+
+static void *slab_fail_request(size_t len, void *priv)
+{
+	if(len == MEMORY_SLAB_LEN) {
+		if(! slab_fail_after) {
+			return NULL;
+		}
+		slab_fail_after--;
+	}
+	return libc_malloc_wrap(len, priv);
+}
+
 void usage(char *name)
 {
 	printf("usage: %s <file>\n", name);
@@ -48,8 +65,51 @@ int main(int argc, char *argv[])
 	node_t *env_handle = NULL, *ARGV;
 	int status = 0;
 	memory_state_t ms;
+	mmarena_state_t arena;
+	unsigned int arena_flags = 0;
 
-	node_memstate_init(&ms, libc_malloc_wrap, libc_free_wrap, NULL);
+	/* GC slabs can come from mmap()ed arenas instead of malloc() */
+	if(getenv("PAREN_HUGEPAGES")) {
+		arena_flags |= MMARENA_HUGEPAGE;
+	}
+	if(getenv("PAREN_PREFAULT")) {
+		arena_flags |= MMARENA_PREFAULT;
+	}
+	if(arena_flags) {
+		mmarena_state_init(&arena, MEMORY_SLAB_LEN,
+		                   getenv("PAREN_ARENA_LEN")
+		                     ? strtoul(getenv("PAREN_ARENA_LEN"), NULL, 0) : 0,
+		                   arena_flags, libc_malloc_wrap, libc_free_wrap, NULL);
+		node_memstate_init(&ms, mmarena_request, mmarena_return, &arena);
+	} else if(getenv("PAREN_SLAB_FAIL")) {
+		slab_fail_after = strtoul(getenv("PAREN_SLAB_FAIL"), NULL, 0);
+		node_memstate_init(&ms, slab_fail_request, libc_free_wrap, NULL);
+	} else {
+		node_memstate_init(&ms, libc_malloc_wrap, libc_free_wrap, NULL);
+	}
+
+	/* heap limits in bytes */
+	memory_gc_set_limits(&ms,
+	                     getenv("PAREN_HEAP_SOFT")
+	                       ? strtoul(getenv("PAREN_HEAP_SOFT"), NULL, 0) : 0,
+	                     getenv("PAREN_HEAP_HARD")
+	                       ? strtoul(getenv("PAREN_HEAP_HARD"), NULL, 0) : 0);
+	/* GC steps per KiB allocated */
+	if(getenv("PAREN_GC_PACE")) {
+		memory_gc_set_pace(&ms, strtoul(getenv("PAREN_GC_PACE"), NULL, 0));
+	}
+	/* let the GC pick its pace from how each cycle went */
+	if(getenv("PAREN_GC_ADAPT")) {
+		memory_gc_set_adaptive(&ms, true);
+	}
+	/* finalizers run between top level forms instead of in GC steps */
+	if(getenv("PAREN_DEFER_FIN")) {
+		memory_gc_defer_finalizers(&ms, true);
+	}
+	/* trace the heap on a background thread (GC_CONCURRENT_MARK builds) */
+	if(getenv("PAREN_GC_THREAD")) {
+		memory_gc_start_marker(&ms);
+	}
 
 	if(argc < 2) {
 		goto cleanup;
@@ -65,6 +125,7 @@ int main(int argc, char *argv[])
 	               //| TC_NODE_INIT
 	               //| TC_EVAL
 	               //| TC_FMC_ALLOC
+	               //| TC_ARENA_ALLOC
 	               );
 
 	/* initialize environment */
@@ -125,6 +186,7 @@ int main(int argc, char *argv[])
 		if(eval_stat != EVAL_OK) {
 			status = eval_stat;
 		}
+		memory_gc_clear_oom(&ms);
 
 		node_droproot(eval_in_hdl);
 		node_droproot(eval_out_hdl);
@@ -136,23 +198,72 @@ cleanup:
 	}
 
 	if(getenv("PAREN_MEMSTAT")) {
-		printf("total alloc: %llu total free: %llu iters: %llu cycles: %llu\n",
+		printf("total alloc: %llu total free: %llu iters: %llu cycles: %llu "
+		       "slabs: %llu released slabs: %llu released cells: %llu "
+		       "minor: %llu promoted: %llu young freed: %llu "
+		       "heap: %llu pressure: %llu paced: %llu "
+		       "rc advised: %llu rc applied: %llu marker traced: %llu "
+		       "compacted: %llu region freed: %llu "
+		       "finalize queue: %llu finalized: %llu "
+		       "weak: %llu weak cleared: %llu "
+		       "trial passes: %llu trial freed: %llu large: %llu "
+		       "pace: %llu paced cycles: %llu adapted: %llu\n",
 		       (unsigned long long) memory_gc_count_total(&ms),
 		       (unsigned long long) memory_gc_count_free(&ms),
 		       (unsigned long long) memory_gc_count_iters(&ms),
-		       (unsigned long long) memory_gc_count_cycles(&ms));
+		       (unsigned long long) memory_gc_count_cycles(&ms),
+		       (unsigned long long) memory_gc_count_slabs(&ms),
+		       (unsigned long long) memory_gc_count_released_slabs(&ms),
+		       (unsigned long long) memory_gc_count_released_cells(&ms),
+		       memory_gc_count_minor(&ms),
+		       memory_gc_count_promoted(&ms),
+		       memory_gc_count_young_freed(&ms),
+		       (unsigned long long) memory_gc_count_heap(&ms),
+		       memory_gc_count_pressure(&ms),
+		       memory_gc_count_paced(&ms),
+		       memory_gc_count_rc_advised(&ms),
+		       memory_gc_count_rc_applied(&ms),
+		       memory_gc_count_marker_traced(&ms),
+		       (unsigned long long) memory_gc_count_compacted(&ms),
+		       (unsigned long long) memory_gc_count_region_freed(&ms),
+		       (unsigned long long) memory_gc_count_finalize_queue(&ms),
+		       memory_gc_count_finalized(&ms),
+		       (unsigned long long) memory_gc_count_weak(&ms),
+		       memory_gc_count_weak_cleared(&ms),
+		       memory_gc_count_trial_passes(&ms),
+		       memory_gc_count_trial_freed(&ms),
+		       (unsigned long long) memory_gc_count_large(&ms),
+		       (unsigned long long) memory_gc_pace(&ms),
+		       memory_gc_count_paced_cycles(&ms),
+		       memory_gc_count_adapted(&ms));
 	}
 
 	if(getenv("PAREN_LEAK_CHECK")) {
 		uintptr_t total_alloc, free_alloc;
-		memory_gc_cycle(&ms);
-		memory_gc_cycle(&ms);
+		/* young cells are only promoted near the end of a cycle: do it now
+		   so the cycle in progress is the only one they survive */
+		memory_gc_minor(&ms);
+		/* on worker threads (GC_PARALLEL_CYCLE builds) */
+		if(getenv("PAREN_GC_PARALLEL")) {
+			unsigned int nthreads = strtoul(getenv("PAREN_GC_PARALLEL"),
+			                                NULL, 0);
+			memory_gc_cycle_parallel(&ms, nthreads);
+			memory_gc_cycle_parallel(&ms, nthreads);
+		} else {
+			memory_gc_cycle(&ms);
+			memory_gc_cycle(&ms);
+		}
+		memory_gc_run_finalizers(&ms, 0);
 	    total_alloc = memory_gc_count_total(&ms);
 		free_alloc = memory_gc_count_free(&ms);
 		if(total_alloc != free_alloc) {
 			printf("warning: %llu allocations remain at exit!\n",
 			       (unsigned long long) (total_alloc - free_alloc));
 		}
+		if(memory_gc_count_large(&ms)) {
+			printf("warning: %llu large object bytes remain at exit!\n",
+			       (unsigned long long) memory_gc_count_large(&ms));
+		}
 	}
 
 	if(getenv("PAREN_DUMPMEM")) {
@@ -160,6 +271,9 @@ cleanup:
 	}
 
 	memory_state_reset(&ms);
+	if(arena_flags) {
+		mmarena_state_reset(&arena);
+	}
 
 	return status;
 }
@@ -0,0 +1,5 @@
+#!/bin/bash
+# past the soft limit the GC collects before every heap growth
+diff mem.000_heap-limit.expect <( LD_LIBRARY_PATH=../ PAREN_LEAK_CHECK=1 PAREN_HEAP_SOFT=1 ../paren mem.000_heap-limit ) || exit 1
+# past the hard limit eval unwinds with EVAL_ERR_OUT_OF_MEM (13)
+diff <( echo 13 ) <( LD_LIBRARY_PATH=../ PAREN_HEAP_HARD=1 ../paren mem.000_heap-limit; echo $? )
@@ -0,0 +1,6 @@
+#!/bin/bash
+# GC slabs carved from prefaulted mmap() arenas backed by huge pages
+diff mem.001_arena.expect <( LD_LIBRARY_PATH=../ PAREN_LEAK_CHECK=1 PAREN_HUGEPAGES=1 PAREN_PREFAULT=1 ../paren mem.001_arena ) || exit 1
+# an arena larger than the address space can't be mapped, so the slabs come
+# from malloc() instead
+diff mem.001_arena.expect <( LD_LIBRARY_PATH=../ PAREN_LEAK_CHECK=1 PAREN_PREFAULT=1 PAREN_ARENA_LEN=0x1000000000000 ../paren mem.001_arena )
@@ -0,0 +1,3 @@
+#!/bin/bash
+# marking on a background thread, where built with GC_CONCURRENT_MARK
+diff mem.002_gc-thread.expect <( LD_LIBRARY_PATH=../ PAREN_LEAK_CHECK=1 PAREN_GC_THREAD=1 ../paren mem.002_gc-thread )
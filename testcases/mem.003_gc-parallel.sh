@@ -0,0 +1,3 @@
+#!/bin/bash
+# the exit leak check run on worker threads, where built with GC_PARALLEL_CYCLE
+diff mem.003_gc-parallel.expect <( LD_LIBRARY_PATH=../ PAREN_LEAK_CHECK=1 PAREN_GC_PARALLEL=3 ../paren mem.003_gc-parallel )
@@ -0,0 +1,4 @@
+#!/bin/bash
+# the heap compacted between every top level form, and not between the forms
+# a lambda reads with _read-eval (mem.004_compact.inner)
+diff mem.004_compact.expect <( LD_LIBRARY_PATH=../ PAREN_LEAK_CHECK=1 PAREN_COMPACT=1 ../paren mem.004_compact )
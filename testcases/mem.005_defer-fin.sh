@@ -0,0 +1,3 @@
+#!/bin/bash
+# finalizers queued by the GC and run between top level forms
+diff mem.005_defer-fin.expect <( LD_LIBRARY_PATH=../ PAREN_LEAK_CHECK=1 PAREN_DEFER_FIN=1 PAREN_GC_PACE=1000 ../paren mem.005_defer-fin )
@@ -0,0 +1,3 @@
+#!/bin/bash
+# a weak handle reads as nil once its target is collected
+diff mem.006_weak.expect <( LD_LIBRARY_PATH=../ PAREN_LEAK_CHECK=1 ../paren mem.006_weak )
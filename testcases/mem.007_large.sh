@@ -0,0 +1,8 @@
+#!/bin/bash
+# 64 MiB of blob payloads churned through a 16 MiB heap: the payloads count
+# toward the limits, so the GC frees the dead ones before the heap outgrows
+# them, whether paced or only under pressure
+diff mem.007_large.expect <( LD_LIBRARY_PATH=../ PAREN_LEAK_CHECK=1 PAREN_HEAP_SOFT=8388608 PAREN_HEAP_HARD=16777216 ../paren mem.007_large ) || exit 1
+diff mem.007_large.expect <( LD_LIBRARY_PATH=../ PAREN_LEAK_CHECK=1 PAREN_GC_PACE=0 PAREN_HEAP_SOFT=8388608 PAREN_HEAP_HARD=16777216 ../paren mem.007_large ) || exit 1
+# a payload larger than the hard limit fails with EVAL_ERR_OUT_OF_MEM (13)
+diff <( echo 13 ) <( LD_LIBRARY_PATH=../ PAREN_HEAP_HARD=1048576 ../paren mem.007_large > /dev/null; echo $? )
@@ -0,0 +1,11 @@
+#!/bin/bash
+# the GC picks its own pace: a growing live list, then garbage
+diff mem.008_adapt.expect <( LD_LIBRARY_PATH=../ PAREN_LEAK_CHECK=1 PAREN_GC_ADAPT=1 ../paren mem.008_adapt ) || exit 1
+# and it did change the pace, unless no cycle was paced (NODE_NO_INCREMENTAL_GC,
+# NODE_INCREMENTAL_FULL_GC), which leaves the controller nothing to go by
+STAT=$( LD_LIBRARY_PATH=../ PAREN_GC_ADAPT=1 PAREN_MEMSTAT=1 ../paren mem.008_adapt )
+if echo "$STAT" | grep -q "paced cycles: 0 "; then
+	echo "$STAT" | grep -q "adapted: 0$"
+else
+	echo "$STAT" | grep -q "adapted: [1-9]"
+fi
@@ -0,0 +1,6 @@
+#!/bin/bash
+# cells still live at exit are torn down with their slabs, but their
+# finalizers run, whether deferred or not and whatever the slabs came from
+diff mem.009_teardown.expect <( LD_LIBRARY_PATH=../ ../paren mem.009_teardown ) || exit 1
+diff mem.009_teardown.expect <( LD_LIBRARY_PATH=../ PAREN_DEFER_FIN=1 ../paren mem.009_teardown ) || exit 1
+diff mem.009_teardown.expect <( LD_LIBRARY_PATH=../ PAREN_PREFAULT=1 ../paren mem.009_teardown )
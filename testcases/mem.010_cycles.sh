@@ -0,0 +1,14 @@
+#!/bin/bash
+# a garbage cycle made by every call, at a pace too low for the trace to
+# keep up with
+diff mem.010_cycles.expect <( LD_LIBRARY_PATH=../ PAREN_LEAK_CHECK=1 PAREN_GC_PACE=8 ../paren mem.010_cycles ) || exit 1
+# the GC_CYCLE_COLLECT trial deletion passes freed some of them, unless no
+# pass ran or cycles run outside the pace (NODE_INCREMENTAL_FULL_GC) traced
+# them away first
+STAT=$( LD_LIBRARY_PATH=../ PAREN_GC_PACE=8 PAREN_MEMSTAT=1 ../paren mem.010_cycles )
+CYCLES=$( echo "$STAT" | sed -n 's/.* cycles: \([0-9]*\) slabs: .*/\1/p' )
+PACED=$( echo "$STAT" | sed -n 's/.* paced cycles: \([0-9]*\) .*/\1/p' )
+if echo "$STAT" | grep -q "trial passes: 0 " || [ "$CYCLES" != "$PACED" ]; then
+	exit 0
+fi
+echo "$STAT" | grep -q "trial freed: [1-9]"
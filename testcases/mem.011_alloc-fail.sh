@@ -0,0 +1,9 @@
+#!/bin/bash
+# a live list needing some 8 GC slabs
+diff mem.011_alloc-fail.expect <( LD_LIBRARY_PATH=../ PAREN_LEAK_CHECK=1 ../paren mem.011_alloc-fail ) || exit 1
+# when the allocator fails a slab request eval unwinds with
+# EVAL_ERR_OUT_OF_MEM (13), unless there are no slabs (NO_GC_FREELIST)
+if LD_LIBRARY_PATH=../ PAREN_MEMSTAT=1 ../paren mem.011_alloc-fail | grep -q " cycles: [0-9]* slabs: 0 "; then
+	exit 0
+fi
+diff <( echo 13 ) <( LD_LIBRARY_PATH=../ PAREN_SLAB_FAIL=4 ../paren mem.011_alloc-fail > /dev/null; echo $? )
@@ -0,0 +1,12 @@
+#!/bin/bash
+# every top level form in a scratch region of its own: def!/set! values, a
+# closure and a continuation outlive the release of the region they were
+# made in
+diff mem.012_region.expect <( LD_LIBRARY_PATH=../ PAREN_LEAK_CHECK=1 PAREN_REGION=1 ../paren mem.012_region ) || exit 1
+# and the release freed the rest, unless region cells are simply left to the
+# GC (NO_GC_FREELIST)
+STAT=$( LD_LIBRARY_PATH=../ PAREN_REGION=1 PAREN_MEMSTAT=1 ../paren mem.012_region )
+if echo "$STAT" | grep -q " cycles: [0-9]* slabs: 0 "; then
+	exit 0
+fi
+echo "$STAT" | grep -q "region freed: [1-9]"
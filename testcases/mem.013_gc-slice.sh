@@ -0,0 +1,16 @@
+#!/bin/bash
+# GC slices run between forms: one bounded by steps runs all of them while
+# there is work, also under a generous time bound, one bounded by time alone
+# runs some, and once idle a slice returns after one step. The live list is
+# the same after them, whether or not allocation paces the GC as well.
+EXPECT=$( cat mem.013_gc-slice.expect )
+# where every node operation runs a full cycle (NODE_INCREMENTAL_FULL_GC),
+# which shows as more cycles than cells, the slices find the GC idle
+STAT=$( LD_LIBRARY_PATH=../ PAREN_MEMSTAT=1 ../paren mem.013_gc-slice | tail -n 1 )
+TOTAL=$( echo "$STAT" | sed -n 's/^total alloc: \([0-9]*\) .*/\1/p' )
+CYCLES=$( echo "$STAT" | sed -n 's/.* cycles: \([0-9]*\) slabs: .*/\1/p' )
+if [ "$CYCLES" -gt "$TOTAL" ]; then
+	EXPECT=$( echo "$EXPECT" | sed '2,3s/^16 $/1 /' )
+fi
+diff <( echo "$EXPECT" ) <( LD_LIBRARY_PATH=../ PAREN_LEAK_CHECK=1 ../paren mem.013_gc-slice ) || exit 1
+diff <( echo "$EXPECT" ) <( LD_LIBRARY_PATH=../ PAREN_LEAK_CHECK=1 PAREN_GC_PACE=0 ../paren mem.013_gc-slice )
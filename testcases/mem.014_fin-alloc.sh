@@ -0,0 +1,7 @@
+#!/bin/bash
+# finalizers run by GC steps, nursery collections and heap pressure request
+# cells in turn: the GC work they cause waits for a later request
+diff mem.014_fin-alloc.expect <( LD_LIBRARY_PATH=../ PAREN_LEAK_CHECK=1 ../paren mem.014_fin-alloc ) || exit 1
+diff mem.014_fin-alloc.expect <( LD_LIBRARY_PATH=../ PAREN_LEAK_CHECK=1 PAREN_GC_PACE=1024 ../paren mem.014_fin-alloc ) || exit 1
+diff mem.014_fin-alloc.expect <( LD_LIBRARY_PATH=../ PAREN_LEAK_CHECK=1 PAREN_HEAP_SOFT=65536 ../paren mem.014_fin-alloc ) || exit 1
+diff mem.014_fin-alloc.expect <( LD_LIBRARY_PATH=../ PAREN_LEAK_CHECK=1 PAREN_DEFER_FIN=1 ../paren mem.014_fin-alloc )
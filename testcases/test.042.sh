@@ -0,0 +1,5 @@
+#!/bin/bash
+# def! without a value fails with EVAL_ERR_EXPECTED_CONS (8), and eval still
+# pops its root slots on the way out
+diff test.042.expect <( LD_LIBRARY_PATH=../ PAREN_LEAK_CHECK=1 ../paren test.042 ) || exit 1
+diff <( echo 8 ) <( LD_LIBRARY_PATH=../ ../paren test.042 > /dev/null; echo $? )
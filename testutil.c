@@ -34,9 +34,197 @@ eval_err_t testutil_node_print_pretty(
 	return extract_args(ms, 1, do_node_print_pretty, args, result, NULL);
 }
 
+static void finblob_fin(void *addr)
+{
+	stream_putln(g_stream_stdout, "finalized");
+}
+
+/* a blob that reports when its finalizer runs */
+static eval_err_t do_finblob(memory_state_t *ms, node_t **args, node_t **result, void *p)
+{
+	*result = node_blob_new(ms, NULL, finblob_fin, 0);
+	return EVAL_OK;
+}
+eval_err_t testutil_finblob(
+	memory_state_t *ms,
+	node_t *args,
+	node_t *env_handle,
+	node_t **result)
+{
+	return extract_args(ms, 0, do_finblob, args, result, NULL);
+}
+
+static unsigned long allocblob_len;
+static unsigned long allocblob_count;
+
+/* requests cells from the state the blob was made in, as if to log it
+   somewhere. The blob must be garbage before exit: finalizers run by
+   memory_state_reset() must not request memory. */
+static void allocblob_fin(void *addr)
+{
+	unsigned long i;
+
+	for(i = 0; i < allocblob_len; i++) {
+		node_droproot(node_value_new((memory_state_t *) addr, i));
+	}
+	allocblob_count++;
+}
+
+/* a blob whose finalizer requests the given number of value nodes */
+static eval_err_t do_allocblob(memory_state_t *ms, node_t **args, node_t **result, void *p)
+{
+	if(node_type(args[0]) != NODE_VALUE) {
+		*result = args[0];
+		return eval_err(EVAL_ERR_EXPECTED_VALUE);
+	}
+	if(node_value(args[0]) < 0) {
+		*result = args[0];
+		return eval_err(EVAL_ERR_VALUE_BOUNDS);
+	}
+	allocblob_len = node_value(args[0]);
+	*result = node_blob_new(ms, ms, allocblob_fin, 0);
+	return EVAL_OK;
+}
+eval_err_t testutil_allocblob(
+	memory_state_t *ms,
+	node_t *args,
+	node_t *env_handle,
+	node_t **result)
+{
+	return extract_args(ms, 1, do_allocblob, args, result, NULL);
+}
+
+/* the finalizers of testutil:allocblob run so far */
+static eval_err_t do_allocblob_count(memory_state_t *ms, node_t **args, node_t **result, void *p)
+{
+	*result = node_value_new(ms, allocblob_count);
+	return EVAL_OK;
+}
+eval_err_t testutil_allocblob_count(
+	memory_state_t *ms,
+	node_t *args,
+	node_t *env_handle,
+	node_t **result)
+{
+	return extract_args(ms, 0, do_allocblob_count, args, result, NULL);
+}
+
+/* a blob with a payload of the given number of bytes from the large object
+   space */
+static eval_err_t do_bigblob(memory_state_t *ms, node_t **args, node_t **result, void *p)
+{
+	if(node_type(args[0]) != NODE_VALUE) {
+		*result = args[0];
+		return eval_err(EVAL_ERR_EXPECTED_VALUE);
+	}
+	if(node_value(args[0]) <= 0) {
+		*result = args[0];
+		return eval_err(EVAL_ERR_VALUE_BOUNDS);
+	}
+	*result = node_blob_alloc(ms, node_value(args[0]), NULL, 0);
+	if(! *result) {
+		return eval_err(EVAL_ERR_OUT_OF_MEM);
+	}
+	return EVAL_OK;
+}
+eval_err_t testutil_bigblob(
+	memory_state_t *ms,
+	node_t *args,
+	node_t *env_handle,
+	node_t **result)
+{
+	return extract_args(ms, 1, do_bigblob, args, result, NULL);
+}
+
+/* collect the nursery and run two full GC cycles, so whatever was
+   unreachable before the call has been freed */
+static eval_err_t do_gc(memory_state_t *ms, node_t **args, node_t **result, void *p)
+{
+	memory_gc_minor(ms);
+	memory_gc_cycle(ms);
+	memory_gc_cycle(ms);
+	*result = NULL;
+	return EVAL_OK;
+}
+eval_err_t testutil_gc(
+	memory_state_t *ms,
+	node_t *args,
+	node_t *env_handle,
+	node_t **result)
+{
+	return extract_args(ms, 0, do_gc, args, result, NULL);
+}
+
+/* run a GC slice of up to n steps and ns nanoseconds (0 is no limit for
+   either) and return the steps it ran */
+static eval_err_t do_gcslice(memory_state_t *ms, node_t **args, node_t **result, void *p)
+{
+	if(node_type(args[0]) != NODE_VALUE) {
+		*result = args[0];
+		return eval_err(EVAL_ERR_EXPECTED_VALUE);
+	}
+	if(node_type(args[1]) != NODE_VALUE) {
+		*result = args[1];
+		return eval_err(EVAL_ERR_EXPECTED_VALUE);
+	}
+	if(node_value(args[0]) < 0) {
+		*result = args[0];
+		return eval_err(EVAL_ERR_VALUE_BOUNDS);
+	}
+	if(node_value(args[1]) < 0) {
+		*result = args[1];
+		return eval_err(EVAL_ERR_VALUE_BOUNDS);
+	}
+	*result = node_value_new(ms, memory_gc_iterate_n(ms, node_value(args[0]),
+	                                                 node_value(args[1])));
+	return EVAL_OK;
+}
+eval_err_t testutil_gcslice(
+	memory_state_t *ms,
+	node_t *args,
+	node_t *env_handle,
+	node_t **result)
+{
+	return extract_args(ms, 2, do_gcslice, args, result, NULL);
+}
+
+/* run GC slices until there is nothing left to collect, then return the
+   steps one more slice of up to n steps runs. Eval allocates between two
+   calls from a script, so only here is the GC still idle for the second. */
+static eval_err_t do_gcidle(memory_state_t *ms, node_t **args, node_t **result, void *p)
+{
+	if(node_type(args[0]) != NODE_VALUE) {
+		*result = args[0];
+		return eval_err(EVAL_ERR_EXPECTED_VALUE);
+	}
+	if(node_value(args[0]) <= 0) {
+		*result = args[0];
+		return eval_err(EVAL_ERR_VALUE_BOUNDS);
+	}
+	memory_gc_iterate_n(ms, 0, 0);
+	*result = node_value_new(ms, memory_gc_iterate_n(ms, node_value(args[0]),
+	                                                 0));
+	return EVAL_OK;
+}
+eval_err_t testutil_gcidle(
+	memory_state_t *ms,
+	node_t *args,
+	node_t *env_handle,
+	node_t **result)
+{
+	return extract_args(ms, 1, do_gcidle, args, result, NULL);
+}
+
 struct { char *name, *nmemonic; } testutil_data_names[] = {
 	{ "testutil_node_print",        "testutil:nodeprint" },
 	{ "testutil_node_print_pretty", "testutil:nodeprintpretty" },
+	{ "testutil_finblob",           "testutil:finblob" },
+	{ "testutil_gc",                "testutil:gc" },
+	{ "testutil_bigblob",           "testutil:bigblob" },
+	{ "testutil_gcslice",           "testutil:gcslice" },
+	{ "testutil_gcidle",            "testutil:gcidle" },
+	{ "testutil_allocblob",         "testutil:allocblob" },
+	{ "testutil_allocblob_count",   "testutil:allocblob-count" },
 };
 
 size_t testutil_data_count =
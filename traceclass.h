@@ -13,6 +13,7 @@ X_ITEM (TC_NODE_GC,    0x0000000000000010) \
 X_ITEM (TC_NODE_INIT,  0x0000000000000020) \
 X_ITEM (TC_EVAL,       0x0000000000000040) \
 X_ITEM (TC_FMC_ALLOC,  0x0000000000000080) \
+X_ITEM (TC_ARENA_ALLOC,0x0000000000000100) \
 X_GROUP(TC_ALL,        0xFFFFFFFFFFFFFFFF) \
 
 